@@ -0,0 +1,440 @@
+#include "BatchSolver.hpp"
+#include "Metrics.hpp"
+#include "RequestArena.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+
+using namespace std;
+
+namespace {
+
+// graphs per pool item
+const size_t SOLVE_BLOCK = 64;
+
+// Sums and path lengths: 64-bit for integral weights, double for floating-point ones
+template <typename Weight>
+using Length = conditional_t<is_floating_point_v<Weight>, double, long long>;
+
+template <typename Weight>
+using EdgeBuffer = pmr::vector<BatchEdge<Weight>>;
+
+// Next whitespace-separated token from pos, empty at the end of the line
+string_view nextToken(string_view line, size_t &pos) {
+    while (pos < line.size() && isspace(static_cast<unsigned char>(line[pos])))
+        ++pos;
+    size_t start = pos;
+    while (pos < line.size() && !isspace(static_cast<unsigned char>(line[pos])))
+        ++pos;
+    return line.substr(start, pos - start);
+}
+
+template <typename T>
+bool parseNumber(string_view token, T &value) {
+    const char *end = token.data() + token.size();
+    auto parsed = from_chars(token.data(), end, value);
+    return !token.empty() && parsed.ec == errc() && parsed.ptr == end;
+}
+
+// Same rule as parseWeight: a token with '.', 'e' or 'E' is floating-point
+bool parseWeightToken(string_view token, WeightValue &weight) {
+    if (token.find_first_of(".eE") == string_view::npos) {
+        long long value;
+        if (!parseNumber(token, value))
+            return false;
+        weight = value;
+        return true;
+    }
+    double value;
+    if (!parseNumber(token, value))
+        return false;
+    weight = value;
+    return true;
+}
+
+int findRoot(pmr::vector<int> &parent, int v) {
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+// Bits that hold every value 0 .. max
+int bitsFor(uint64_t max) {
+    int bits = 0;
+    while (bits < 64 && (max >> bits) != 0)
+        ++bits;
+    return bits;
+}
+
+// Same (weight, u, v) order with u < v as the kruskal command, so ties pick the same tree.
+// An integral weight, as an offset from the lightest, and both endpoints usually fit one
+// 64-bit key in that order, and keys compare in one instruction instead of three.
+template <typename Weight>
+void kruskalForest(const BatchEdge<Weight> *edges, size_t count, int vertices, EdgeBuffer<Weight> &tree,
+                   pmr::memory_resource *arena) {
+    EdgeBuffer<Weight> sorted(arena);
+    sorted.reserve(count);
+    Weight lightest = numeric_limits<Weight>::max(), heaviest = numeric_limits<Weight>::lowest();
+    for (size_t i = 0; i < count; ++i) {
+        BatchEdge<Weight> edge = edges[i];
+        if (edge.u == edge.v)
+            continue;
+        if (edge.u > edge.v)
+            swap(edge.u, edge.v);
+        sorted.push_back(edge);
+        lightest = min(lightest, edge.weight);
+        heaviest = max(heaviest, edge.weight);
+    }
+
+    int vertexBits = bitsFor(static_cast<uint64_t>(vertices - 1));
+    bool packed = false;
+    if constexpr (is_integral_v<Weight>) {
+        packed = !sorted.empty() &&
+                 2 * vertexBits + bitsFor(static_cast<uint64_t>(heaviest) - static_cast<uint64_t>(lightest)) <= 64;
+    }
+    if (packed) {
+        pmr::vector<uint64_t> keys(arena);
+        keys.reserve(sorted.size());
+        for (const auto &edge : sorted)
+            keys.push_back((static_cast<uint64_t>(edge.weight) - static_cast<uint64_t>(lightest)) << (2 * vertexBits) |
+                           static_cast<uint64_t>(edge.u) << vertexBits | static_cast<uint64_t>(edge.v));
+        sort(keys.begin(), keys.end());
+        uint64_t vertexMask = (uint64_t(1) << vertexBits) - 1;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sorted[i] = {static_cast<Weight>(static_cast<uint64_t>(lightest) + (keys[i] >> (2 * vertexBits))),
+                         static_cast<int>((keys[i] >> vertexBits) & vertexMask), static_cast<int>(keys[i] & vertexMask)};
+        }
+    }
+    else {
+        sort(sorted.begin(), sorted.end(), [](const BatchEdge<Weight> &a, const BatchEdge<Weight> &b) {
+            return tie(a.weight, a.u, a.v) < tie(b.weight, b.u, b.v);
+        });
+    }
+
+    pmr::vector<int> parent(vertices, arena);
+    iota(parent.begin(), parent.end(), 0);
+    for (const auto &edge : sorted) {
+        if (static_cast<int>(tree.size()) == vertices - 1)
+            break;
+        int a = findRoot(parent, edge.u), b = findRoot(parent, edge.v);
+        if (a == b)
+            continue;
+        parent[a] = b;
+        tree.push_back(edge);
+    }
+}
+
+// Prim without a heap: the nearest vertex is found by scanning the fringe, the reached
+// vertices not yet in the tree, which stays short in sparse graphs and in cache in dense
+// ones. It takes the lowest (key, vertex) like the prim command's heap, so ties pick the
+// same tree. When the fringe runs dry, the lowest unreached vertex starts the next tree,
+// so a disconnected graph gets its spanning forest.
+template <typename Weight>
+void primForest(const BatchEdge<Weight> *edges, size_t count, int vertices, EdgeBuffer<Weight> &tree,
+                pmr::memory_resource *arena) {
+    pmr::vector<size_t> offsets(vertices + 1, 0, arena);
+    for (size_t i = 0; i < count; ++i) {
+        ++offsets[edges[i].u + 1];
+        ++offsets[edges[i].v + 1];
+    }
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    pmr::vector<size_t> next(offsets.begin(), offsets.end() - 1, arena);
+    pmr::vector<int> targets(2 * count, arena);
+    pmr::vector<Weight> weights(2 * count, arena);
+    for (size_t i = 0; i < count; ++i) {
+        const BatchEdge<Weight> &edge = edges[i];
+        targets[next[edge.u]] = edge.v;
+        weights[next[edge.u]++] = edge.weight;
+        targets[next[edge.v]] = edge.u;
+        weights[next[edge.v]++] = edge.weight;
+    }
+
+    pmr::vector<Weight> key(vertices, arena);
+    // the tree vertex a reached vertex's key comes from, -1 while unreached
+    pmr::vector<int> from(vertices, -1, arena);
+    pmr::vector<char> inTree(vertices, 0, arena);
+    pmr::vector<int> fringe(arena);
+    fringe.reserve(vertices);
+    // vertices below nextRoot are all in the tree
+    int nextRoot = 0;
+    for (int added = 0; added < vertices; ++added) {
+        int u;
+        if (fringe.empty()) {
+            while (inTree[nextRoot])
+                ++nextRoot;
+            u = nextRoot;
+        }
+        else {
+            size_t best = 0;
+            for (size_t i = 1; i < fringe.size(); ++i) {
+                int v = fringe[i], b = fringe[best];
+                if (key[v] < key[b] || (key[v] == key[b] && v < b))
+                    best = i;
+            }
+            u = fringe[best];
+            fringe[best] = fringe.back();
+            fringe.pop_back();
+            tree.push_back({key[u], from[u], u});
+        }
+        inTree[u] = 1;
+        for (size_t i = offsets[u]; i < offsets[u + 1]; ++i) {
+            int v = targets[i];
+            if (inTree[v])
+                continue;
+            if (from[v] < 0)
+                fringe.push_back(v);
+            else if (!(weights[i] < key[v]))
+                continue;
+            key[v] = weights[i];
+            from[v] = u;
+        }
+    }
+}
+
+template <typename Weight>
+struct ForestMeasurements
+{
+    Length<Weight> total = 0, longest = 0;
+    Weight shortest = Weight();
+    // over unordered pairs of vertices in the same tree
+    double distanceSum = 0;
+    long long pairs = 0;
+    int components = 0;
+};
+
+// One sweep per tree: subtree sizes give the distance sum edge by edge (weight times the
+// pairs it separates), and the longest downward paths met at each vertex give the diameter
+template <typename Weight>
+ForestMeasurements<Weight> measureForest(const EdgeBuffer<Weight> &tree, int vertices, pmr::memory_resource *arena) {
+    using Dist = Length<Weight>;
+    ForestMeasurements<Weight> result;
+    pmr::vector<size_t> offsets(vertices + 1, 0, arena);
+    for (size_t i = 0; i < tree.size(); ++i) {
+        const BatchEdge<Weight> &edge = tree[i];
+        ++offsets[edge.u + 1];
+        ++offsets[edge.v + 1];
+        result.total += edge.weight;
+        result.shortest = i == 0 ? edge.weight : min(result.shortest, edge.weight);
+    }
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    pmr::vector<size_t> next(offsets.begin(), offsets.end() - 1, arena);
+    pmr::vector<pair<int, Weight>> adjacent(2 * tree.size(), arena);
+    for (const auto &edge : tree) {
+        adjacent[next[edge.u]++] = {edge.v, edge.weight};
+        adjacent[next[edge.v]++] = {edge.u, edge.weight};
+    }
+
+    // BFS order puts every parent before its children; the reverse sweep sees children first
+    pmr::vector<int> order(arena);
+    order.reserve(vertices);
+    pmr::vector<int> parent(vertices, -1, arena);
+    pmr::vector<Weight> up(vertices, Weight(), arena);
+    pmr::vector<int> size(vertices, 1, arena);
+    pmr::vector<Dist> down(vertices, 0, arena);
+    pmr::vector<char> visited(vertices, 0, arena);
+    for (int root = 0; root < vertices; ++root) {
+        if (visited[root])
+            continue;
+        ++result.components;
+        size_t begin = order.size();
+        order.push_back(root);
+        visited[root] = 1;
+        for (size_t i = begin; i < order.size(); ++i) {
+            int u = order[i];
+            for (size_t j = offsets[u]; j < offsets[u + 1]; ++j) {
+                int v = adjacent[j].first;
+                if (visited[v])
+                    continue;
+                visited[v] = 1;
+                parent[v] = u;
+                up[v] = adjacent[j].second;
+                order.push_back(v);
+            }
+        }
+
+        long long treeSize = static_cast<long long>(order.size() - begin);
+        result.pairs += treeSize * (treeSize - 1) / 2;
+        for (size_t i = order.size() - 1; i > begin; --i) {
+            int v = order[i], p = parent[v];
+            Dist path = down[v] + up[v];
+            // down[p] is still the longest path through p's children swept so far
+            result.longest = max(result.longest, down[p] + path);
+            down[p] = max(down[p], path);
+            size[p] += size[v];
+            result.distanceSum += static_cast<double>(up[v]) * size[v] * (treeSize - size[v]);
+        }
+    }
+    return result;
+}
+
+void appendNumber(string &out, long long value) {
+    char buffer[32];
+    out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+}
+
+// six significant digits, like the stream output of the other commands
+void appendNumber(string &out, double value) {
+    char buffer[32];
+    out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value, chars_format::general, 6).ptr);
+}
+
+void appendNumber(string &out, const WeightValue &value) {
+    visit([&out](auto number) { appendNumber(out, number); }, value);
+}
+
+} // namespace
+
+BatchSolver::Strategy BatchSolver::parseStrategy(const string &name) {
+    if (name == "kruskal")
+        return Strategy::KRUSKAL;
+    if (name == "prim")
+        return Strategy::PRIM;
+    throw runtime_error("Unknown strategy");
+}
+
+void BatchSolver::addGraph(string_view line) {
+    Entry &entry = entries.emplace_back();
+    size_t pos = 0;
+    int vertices = 0, edges = 0;
+    if (!parseNumber(nextToken(line, pos), vertices) || !parseNumber(nextToken(line, pos), edges)) {
+        entry.error = "Invalid graph: expected vertices and edges first";
+        return;
+    }
+    if (vertices <= 0 || vertices > MAX_VERTICES || edges < 0 || edges > MAX_EDGES) {
+        entry.error = "Invalid graph: a batch graph has 1 .. " + to_string(MAX_VERTICES) +
+                      " vertices and at most " + to_string(MAX_EDGES) + " edges";
+        return;
+    }
+
+    parsedEnds.clear();
+    parsedWeights.clear();
+    bool integral = true;
+    for (int i = 0; i < edges; ++i) {
+        int u = 0, v = 0;
+        WeightValue weight;
+        if (!parseNumber(nextToken(line, pos), u) || !parseNumber(nextToken(line, pos), v) ||
+            !parseWeightToken(nextToken(line, pos), weight)) {
+            entry.error = "Invalid edge " + to_string(i);
+            return;
+        }
+        if (u < 0 || u >= vertices || v < 0 || v >= vertices) {
+            entry.error = "Invalid vertex in edge " + to_string(i);
+            return;
+        }
+        integral = integral && holds_alternative<long long>(weight);
+        parsedEnds.push_back({u, v});
+        parsedWeights.push_back(weight);
+    }
+    if (!nextToken(line, pos).empty()) {
+        entry.error = "Invalid graph: more than " + to_string(edges) + " edges";
+        return;
+    }
+
+    entry.vertices = vertices;
+    entry.integral = integral;
+    entry.count = edges;
+    if (integral) {
+        entry.first = intEdges.size();
+        for (int i = 0; i < edges; ++i)
+            intEdges.push_back({get<long long>(parsedWeights[i]), parsedEnds[i].first, parsedEnds[i].second});
+    }
+    else {
+        entry.first = realEdges.size();
+        for (int i = 0; i < edges; ++i) {
+            double weight = visit([](auto value) { return static_cast<double>(value); }, parsedWeights[i]);
+            realEdges.push_back({weight, parsedEnds[i].first, parsedEnds[i].second});
+        }
+    }
+}
+
+size_t BatchSolver::size() const {
+    return entries.size();
+}
+
+size_t BatchSolver::edgeCount() const {
+    return intEdges.size() + realEdges.size();
+}
+
+size_t BatchSolver::failedCount() const {
+    return count_if(entries.begin(), entries.end(), [](const Entry &entry) { return !entry.error.empty(); });
+}
+
+template <typename Weight>
+void BatchSolver::solveGraph(const BatchEdge<Weight> *edges, Strategy strategy, Entry &entry) {
+    RequestArena::Scope arenaScope;
+    pmr::memory_resource *arena = RequestArena::resource();
+
+    EdgeBuffer<Weight> tree(arena);
+    tree.reserve(entry.vertices - 1);
+    if (strategy == Strategy::KRUSKAL)
+        kruskalForest(edges, entry.count, entry.vertices, tree, arena);
+    else
+        primForest(edges, entry.count, entry.vertices, tree, arena);
+
+    ForestMeasurements<Weight> measured = measureForest(tree, entry.vertices, arena);
+    if (measured.pairs == 0) {
+        entry.error = "No valid pairs found in MST";
+        return;
+    }
+    entry.totalWeight = widenWeight(measured.total);
+    entry.longestDistance = widenWeight(measured.longest);
+    entry.shortestMSTDistance = widenWeight(measured.shortest);
+    entry.averageDistance = measured.distanceSum / measured.pairs;
+    entry.components = measured.components;
+}
+
+void BatchSolver::solve(ThreadPoll &pool, Strategy strategy) {
+    size_t blocks = (entries.size() + SOLVE_BLOCK - 1) / SOLVE_BLOCK;
+    pool.parallelFor(blocks, [&](size_t block) {
+        size_t last = min(entries.size(), (block + 1) * SOLVE_BLOCK);
+        for (size_t i = block * SOLVE_BLOCK; i < last; ++i) {
+            Entry &entry = entries[i];
+            if (!entry.error.empty())
+                continue;
+            if (entry.integral)
+                solveGraph(intEdges.data() + entry.first, strategy, entry);
+            else
+                solveGraph(realEdges.data() + entry.first, strategy, entry);
+        }
+    });
+    Metrics::add(Metrics::BATCH_GRAPHS, static_cast<int64_t>(entries.size()));
+}
+
+void BatchSolver::appendResults(string &out, size_t firstIndex) const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry &entry = entries[i];
+        appendNumber(out, static_cast<long long>(firstIndex + i));
+        if (!entry.error.empty()) {
+            out += " error ";
+            out += entry.error;
+            out += '\n';
+            continue;
+        }
+        out += ' ';
+        appendNumber(out, entry.totalWeight);
+        out += ' ';
+        appendNumber(out, entry.longestDistance);
+        out += ' ';
+        appendNumber(out, entry.averageDistance);
+        out += ' ';
+        appendNumber(out, entry.shortestMSTDistance);
+        out += ' ';
+        appendNumber(out, static_cast<long long>(entry.components));
+        out += '\n';
+    }
+}
+
+void BatchSolver::clear() {
+    entries.clear();
+    intEdges.clear();
+    realEdges.clear();
+}
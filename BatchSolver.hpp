@@ -0,0 +1,83 @@
+#ifndef BATCH_SOLVER_HPP
+#define BATCH_SOLVER_HPP
+
+#include "Graph.hpp"
+#include "ThreadPoll.hpp"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// One edge of a packed batch graph
+template <typename Weight>
+struct BatchEdge
+{
+    Weight weight;
+    int u, v;
+};
+
+//This class solves many small graphs sent in one request. Each graph arrives as a single
+//line, "vertices edges u v w u v w ...", and is packed into edge arrays shared by the whole
+//batch instead of becoming a ClientGraph. solve() splits the graphs across the compute pool;
+//every graph is solved and measured inside the thread's request arena, reset after each one,
+//so a warmed-up thread allocates nothing and a graph's working set stays in cache.
+//Parallel edges and self-loops are kept, as under the default duplicate policy.
+class BatchSolver
+{
+public:
+    // Larger graphs belong in init, which keeps them for edits and paths
+    static const int MAX_VERTICES = 1024;
+    static const int MAX_EDGES = 65536;
+
+    enum class Strategy
+    {
+        KRUSKAL,
+        PRIM
+    };
+    // Throws for names other than kruskal and prim
+    static Strategy parseStrategy(const string &name);
+
+    // Packs one graph line. A malformed graph is kept as a failed entry, so result indices
+    // stay those of the input lines.
+    void addGraph(string_view line);
+    size_t size() const;
+    // Packed edges of all graphs, for bounding a chunk
+    size_t edgeCount() const;
+    size_t failedCount() const;
+
+    void solve(ThreadPoll &pool, Strategy strategy);
+    // One line per graph, numbered from firstIndex: "index total longest average shortest
+    // components", or "index error message" for a graph that failed
+    void appendResults(string &out, size_t firstIndex) const;
+    // Drops the graphs but keeps the buffers for the next chunk
+    void clear();
+
+private:
+    struct Entry
+    {
+        int vertices = 0;
+        // integral graphs use intEdges, the others realEdges; [first, first + count)
+        bool integral = true;
+        size_t first = 0, count = 0;
+        // set by addGraph or solve; a failed entry has no results
+        string error;
+        WeightValue totalWeight, longestDistance, shortestMSTDistance;
+        double averageDistance = 0;
+        int components = 0;
+    };
+
+    vector<Entry> entries;
+    vector<BatchEdge<long long>> intEdges;
+    vector<BatchEdge<double>> realEdges;
+    // addGraph parses into these before it knows the graph's weight type
+    vector<pair<int, int>> parsedEnds;
+    vector<WeightValue> parsedWeights;
+
+    template <typename Weight>
+    static void solveGraph(const BatchEdge<Weight> *edges, Strategy strategy, Entry &entry);
+};
+
+#endif // BATCH_SOLVER_HPP
@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BatchSolver.hpp"
+#include "EdgeKernels.hpp"
+#include "Graph.hpp"
+#include "GraphGenerator.hpp"
+#include "MSTServer.hpp"
+#include "StrategyFactory.hpp"
+#include "ThreadPoll.hpp"
+
+using namespace std;
+
+struct BenchOptions {
+    vector<string> types = {"random", "grid", "rmat", "complete"};
+    vector<string> strategies = {"kruskal", "prim"};
+    GeneratorConfig generator;
+    int repetitions = 10;
+    int warmup = 2;
+    string outputFile;
+};
+
+// Edges removed per run by the "edges" phases
+const size_t REMOVE_SAMPLE = 1000;
+// The "batch" phases solve this many generated graphs of BATCH_VERTICES vertices per run
+const int BATCH_GRAPHS = 1000;
+const int BATCH_VERTICES = 100;
+
+struct TimingStats {
+    double min, max, mean, median, p95, stddev;
+};
+
+vector<string> split_list(const string &s) {
+    vector<string> items;
+    string item;
+    istringstream iss(s);
+    while (getline(iss, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+void print_usage(const char *prog) {
+    cerr << "Usage: " << prog << " [--types random,grid,rmat,complete] [--strategies kruskal,prim]\n"
+         << "       [--vertices N] [--degree D] [--weights uniform|normal|exponential] [--max-weight W]\n"
+         << "       [--reps R] [--warmup K] [--seed S] [--out results.json]" << endl;
+}
+
+bool parse_option_values(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "--types")
+            options.types = split_list(value);
+        else if (arg == "--strategies")
+            options.strategies = split_list(value);
+        else if (arg == "--vertices")
+            options.generator.vertices = stoi(value);
+        else if (arg == "--degree")
+            options.generator.averageDegree = stod(value);
+        else if (arg == "--weights")
+            options.generator.weights = value;
+        else if (arg == "--max-weight")
+            options.generator.maxWeight = stoi(value);
+        else if (arg == "--reps")
+            options.repetitions = max(1, stoi(value));
+        else if (arg == "--warmup")
+            options.warmup = max(0, stoi(value));
+        else if (arg == "--seed")
+            options.generator.seed = stoull(value);
+        else if (arg == "--out")
+            options.outputFile = value;
+        else {
+            cerr << "Unknown option " << arg << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_options(int argc, char *argv[], BenchOptions &options) {
+    try {
+        return parse_option_values(argc, argv, options);
+    }
+    catch (const logic_error &e) {
+        // stoi/stod report malformed or out-of-range numbers as invalid_argument/out_of_range
+        cerr << "Invalid numeric value (" << e.what() << ")" << endl;
+        return false;
+    }
+}
+
+// Runs `body` warmup + repetitions times and returns the timed samples in milliseconds
+vector<double> time_runs(const BenchOptions &options, const function<void()> &body) {
+    for (int i = 0; i < options.warmup; ++i)
+        body();
+
+    vector<double> samples;
+    for (int i = 0; i < options.repetitions; ++i) {
+        auto start = chrono::steady_clock::now();
+        body();
+        auto end = chrono::steady_clock::now();
+        samples.push_back(chrono::duration<double, milli>(end - start).count());
+    }
+    return samples;
+}
+
+TimingStats summarize(vector<double> samples) {
+    sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    double mean = accumulate(samples.begin(), samples.end(), 0.0) / n;
+    double variance = 0;
+    for (double s : samples)
+        variance += (s - mean) * (s - mean);
+    double median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    size_t p95 = min(n - 1, static_cast<size_t>(ceil(0.95 * n)) - 1);
+    return {samples.front(), samples.back(), mean, median, samples[p95], sqrt(variance / n)};
+}
+
+string json_escape(const string &s) {
+    string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void write_result(ostream &os, bool &first, const string &graphType, const Graph &graph, size_t numEdges,
+                  const string &strategy, const string &phase, const TimingStats &stats, int reps) {
+    os << (first ? "\n" : ",\n")
+       << "    {\"graph\": \"" << json_escape(graphType) << "\", \"vertices\": " << graph.getNumVertices()
+       << ", \"edges\": " << numEdges << ", \"strategy\": \"" << json_escape(strategy)
+       << "\", \"phase\": \"" << phase << "\", \"reps\": " << reps
+       << ", \"min_ms\": " << stats.min << ", \"median_ms\": " << stats.median
+       << ", \"mean_ms\": " << stats.mean << ", \"p95_ms\": " << stats.p95
+       << ", \"max_ms\": " << stats.max << ", \"stddev_ms\": " << stats.stddev << "}";
+    first = false;
+}
+
+// A row for a graph/strategy/phase that threw instead of producing timings
+void write_error(ostream &os, bool &first, const string &graphType, int vertices, size_t numEdges,
+                 const string &strategy, const string &phase, const string &error) {
+    os << (first ? "\n" : ",\n")
+       << "    {\"graph\": \"" << json_escape(graphType) << "\", \"vertices\": " << vertices
+       << ", \"edges\": " << numEdges << ", \"strategy\": \"" << json_escape(strategy)
+       << "\", \"phase\": \"" << phase << "\", \"error\": \"" << json_escape(error) << "\"}";
+    first = false;
+}
+
+// The graph as one line of the batch command: "vertices edges u v w ..."
+string batch_line(const Graph &graph) {
+    auto edges = graph.getEdges();
+    string line = to_string(graph.getNumVertices()) + " " + to_string(edges.size());
+    for (const auto &edge : edges)
+        line += " " + to_string(edge.second.first) + " " + to_string(edge.second.second) + " " + to_string(edge.first);
+    return line;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    ofstream file;
+    if (!options.outputFile.empty()) {
+        file.open(options.outputFile);
+        if (!file) {
+            cerr << "Cannot open " << options.outputFile << endl;
+            return 1;
+        }
+    }
+    ostream &out = options.outputFile.empty() ? cout : file;
+    out.precision(6);
+
+    const GeneratorConfig &gen = options.generator;
+    out << "{\n  \"config\": {\"vertices\": " << gen.vertices << ", \"degree\": " << gen.averageDegree
+        << ", \"weights\": \"" << json_escape(gen.weights) << "\", \"max_weight\": " << gen.maxWeight
+        << ", \"seed\": " << gen.seed << ", \"reps\": " << options.repetitions
+        << ", \"warmup\": " << options.warmup << "},\n  \"results\": [";
+
+    ConcreteStrategyFactory factory;
+    MSTServer server(1);
+    ThreadPoll bfsPool(max(1u, thread::hardware_concurrency()));
+    const int benchClient = 0;
+    bool first = true;
+
+    for (const auto &type : options.types) {
+        GeneratorConfig config = gen;
+        config.type = type;
+        Graph graph(0);
+        try {
+            graph = GraphGenerator(config).generate();
+        }
+        catch (const exception &e) {
+            cerr << "Cannot generate " << type << " graph: " << e.what() << endl;
+            write_error(out, first, type, gen.vertices, 0, "", "generate", e.what());
+            continue;
+        }
+        size_t numEdges = graph.getEdges().size();
+        cerr << "Generated " << type << " graph: " << graph.getNumVertices() << " vertices, "
+             << numEdges << " edges" << endl;
+
+        // Times one phase and writes its row; a throwing phase gets an error row instead
+        auto runPhase = [&](const string &strategyName, const string &phase, const function<void()> &body) {
+            try {
+                TimingStats stats = summarize(time_runs(options, body));
+                write_result(out, first, type, graph, numEdges, strategyName, phase, stats,
+                             options.repetitions);
+                cerr << "  " << strategyName << ": " << phase << " median " << stats.median << " ms"
+                     << endl;
+                return true;
+            }
+            catch (const exception &e) {
+                write_error(out, first, type, graph.getNumVertices(), numEdges, strategyName, phase,
+                            e.what());
+                cerr << "  " << strategyName << ": " << phase << " failed: " << e.what() << endl;
+                return false;
+            }
+        };
+
+        runPhase("bfs", "buildSpanningTree", [&]() { graph.buildSpanningTree(0); });
+        runPhase("bfs", "buildSpanningTreeParallel", [&]() { graph.buildSpanningTree(0, bfsPool); });
+
+        // remove up to REMOVE_SAMPLE evenly spaced edges, from a plain and from an indexed copy
+        vector<Graph::WeightedEdge> removals;
+        {
+            auto edges = graph.getEdges();
+            size_t stride = max<size_t>(1, edges.size() / REMOVE_SAMPLE);
+            for (size_t i = 0; i < edges.size(); i += stride)
+                removals.push_back(edges[i]);
+        }
+        Graph indexed = graph;
+        indexed.setDuplicatePolicy(DuplicatePolicy::KEEP_MIN);
+        runPhase("edges", "removeEdge", [&]() {
+            Graph copy = graph;
+            for (const auto &edge : removals)
+                copy.removeEdge(edge.second.first, edge.second.second);
+        });
+        runPhase("edges", "removeEdgeIndexed", [&]() {
+            Graph copy = indexed;
+            for (const auto &edge : removals)
+                copy.removeEdge(edge.second.first, edge.second.second);
+        });
+
+        // the batched kernels on arrays drawn from this graph, once per instruction set the CPU has;
+        // endpoints folded into 64 trees leave Kruskal's filter a mix of kept and dropped edges
+        {
+            auto edges = graph.getEdges();
+            size_t count = edges.size();
+            vector<int> rootU(count), rootV(count), targets(count), weights(count);
+            vector<int> key(graph.getNumVertices(), gen.maxWeight / 2);
+            vector<uint32_t> positions(count);
+            vector<uint64_t> keys(count), sorting(count), scratch(count);
+            for (size_t i = 0; i < count; ++i) {
+                rootU[i] = edges[i].second.first % 64;
+                rootV[i] = edges[i].second.second % 64;
+                targets[i] = edges[i].second.second;
+                weights[i] = edges[i].first;
+                keys[i] = static_cast<uint64_t>(edges[i].first) << 40 |
+                          static_cast<uint64_t>(edges[i].second.first) << 20 | edges[i].second.second;
+            }
+            KernelIsa best = EdgeKernels::getIsa();
+            for (KernelIsa isa : {KernelIsa::SCALAR, KernelIsa::AVX2}) {
+                if (!EdgeKernels::isSupported(isa))
+                    continue;
+                EdgeKernels::setIsa(isa);
+                string kernels = string("kernels_") + EdgeKernels::isaName(isa);
+                runPhase(kernels, "keepUnconnected", [&]() {
+                    EdgeKernels::keepUnconnected(rootU.data(), rootV.data(), count, positions.data());
+                });
+                runPhase(kernels, "summarize", [&]() {
+                    EdgeKernels::summarize(&edges.data()->first, count, sizeof(Graph::WeightedEdge));
+                });
+                runPhase(kernels, "relaxCandidates", [&]() {
+                    EdgeKernels::relaxCandidates(targets.data(), weights.data(), count, key.data(), positions.data());
+                });
+                runPhase(kernels, "computeMST_kruskal", [&]() { BasicKruskalMST<int, int>().computeMST(graph); });
+                runPhase(kernels, "computeMST_prim", [&]() { BasicPrimMST<int, int>().computeMST(graph); });
+            }
+            EdgeKernels::setIsa(best);
+            // the histogram and radix sort are scalar under every ISA; compared with a comparison sort
+            runPhase("kernels", "radixSort", [&]() {
+                sorting = keys;
+                EdgeKernels::radixSort(sorting.data(), scratch.data(), count);
+            });
+            runPhase("kernels", "sort", [&]() {
+                sorting = keys;
+                sort(sorting.begin(), sorting.end());
+            });
+        }
+
+        server.setGraph(benchClient, graph);
+        for (const auto &strategyName : options.strategies) {
+            unique_ptr<MST> strategy;
+            try {
+                strategy = factory.createStrategy(strategyName);
+            }
+            catch (const exception &e) {
+                write_error(out, first, type, graph.getNumVertices(), numEdges, strategyName, "computeMST",
+                            e.what());
+                cerr << "  " << strategyName << ": " << e.what() << endl;
+                continue;
+            }
+            runPhase(strategyName, "computeMST", [&]() { strategy->computeMST(graph); });
+            // measurements need a stored MST, so skip them when solving fails
+            if (runPhase(strategyName, "solveMST", [&]() { server.solveMST(benchClient, strategyName); }))
+                runPhase(strategyName, "calculateMeasurements", [&]() { server.calculateMeasurements(benchClient); });
+        }
+
+        // the batch command's solver on many small graphs of this type; the rows carry the
+        // first of them, and the time is for all BATCH_GRAPHS
+        BatchSolver batch;
+        Graph sample(0);
+        try {
+            GeneratorConfig small = config;
+            small.vertices = BATCH_VERTICES;
+            for (int i = 0; i < BATCH_GRAPHS; ++i) {
+                small.seed = config.seed + i;
+                Graph generated = GraphGenerator(small).generate();
+                batch.addGraph(batch_line(generated));
+                if (i == 0)
+                    sample = move(generated);
+            }
+        }
+        catch (const exception &e) {
+            write_error(out, first, type, BATCH_VERTICES, 0, "batch", "generate", e.what());
+            cerr << "  batch: cannot generate " << type << " graphs: " << e.what() << endl;
+            continue;
+        }
+        for (const auto &strategyName : options.strategies) {
+            string name = "batch_" + strategyName;
+            try {
+                BatchSolver::Strategy strategy = BatchSolver::parseStrategy(strategyName);
+                TimingStats stats = summarize(time_runs(options, [&]() { batch.solve(bfsPool, strategy); }));
+                write_result(out, first, type, sample, sample.getEdges().size(), name, "solveBatch", stats,
+                             options.repetitions);
+                cerr << "  " << name << ": solveBatch median " << stats.median << " ms, "
+                     << BATCH_GRAPHS / stats.median * 1000 << " graphs/s" << endl;
+            }
+            catch (const exception &e) {
+                write_error(out, first, type, BATCH_VERTICES, 0, name, "solveBatch", e.what());
+                cerr << "  " << name << ": " << e.what() << endl;
+            }
+        }
+    }
+
+    out << "\n  ]\n}" << endl;
+    return 0;
+}
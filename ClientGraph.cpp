@@ -0,0 +1,657 @@
+#include "ClientGraph.hpp"
+#include "GraphVisualizer.hpp"
+#include "Metrics.hpp"
+#include "Components.hpp"
+#include "EdgeKernels.hpp"
+#include "RequestArena.hpp"
+#include "StrategyFactory.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <limits>
+#include <memory_resource>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace std;
+
+namespace {
+
+// Sums and path lengths: 64-bit for integral weights, double for floating-point ones
+template <typename Weight>
+using Length = conditional_t<is_floating_point_v<Weight>, double, long long>;
+
+template <typename T>
+const char *typeLabel() {
+    if constexpr (is_same_v<T, uint16_t>)
+        return "uint16";
+    else if constexpr (is_same_v<T, int>)
+        return "int32";
+    else if constexpr (is_same_v<T, int64_t>)
+        return "int64";
+    else
+        return "double";
+}
+
+// Formats straight into out, without a stream; doubles match ostream's default %g
+template <typename T>
+void appendNumber(string &out, T value) {
+    char buffer[32];
+    if constexpr (is_floating_point_v<T>) {
+        int length = snprintf(buffer, sizeof(buffer), "%g", static_cast<double>(value));
+        out.append(buffer, length);
+    }
+    else {
+        out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+    }
+}
+
+template <typename Weight>
+Weight narrowWeight(const WeightValue &weight) {
+    return visit([](auto value) { return static_cast<Weight>(value); }, weight);
+}
+
+// Forest edges of one component, stored contiguously in the MST edge list
+template <typename Index, typename Weight>
+struct ComponentEdges {
+    const pair<Weight, pair<Index, Index>> *begin;
+    const pair<Weight, pair<Index, Index>> *end;
+};
+
+template <typename Index, typename Weight>
+using TreeAdjacency = pmr::vector<pmr::vector<pair<int, Weight>>>;
+
+// Adjacency of one component's tree over local ids 0 .. size - 1
+template <typename Index, typename Weight>
+TreeAdjacency<Index, Weight> treeAdjacency(ComponentEdges<Index, Weight> edges, size_t size,
+                                           const vector<int> &localId, pmr::memory_resource *arena) {
+    TreeAdjacency<Index, Weight> adjList(size, arena);
+    for (auto edge = edges.begin; edge != edges.end; ++edge) {
+        int u = localId[edge->second.first];
+        int v = localId[edge->second.second];
+        adjList[u].emplace_back(v, edge->first);
+        adjList[v].emplace_back(u, edge->first);
+    }
+    return adjList;
+}
+
+// Total and shortest edge of a component's tree in one pass over its weights
+template <typename Index, typename Weight>
+WeightSummary<Weight> summaryOf(ComponentEdges<Index, Weight> edges) {
+    if (edges.begin == edges.end)
+        return {};
+    return EdgeKernels::summarize(&edges.begin->first, edges.end - edges.begin,
+                                  sizeof(typename BasicGraph<Index, Weight>::WeightedEdge));
+}
+
+// Diameter of a tree: the furthest vertex from any start, then the furthest distance from that one
+template <typename Index, typename Weight>
+Length<Weight> longestDistanceOf(ComponentEdges<Index, Weight> edges, size_t size, const vector<int> &localId) {
+    RequestArena::Scope arenaScope;
+    pmr::memory_resource *arena = RequestArena::resource();
+    auto adjList = treeAdjacency<Index, Weight>(edges, size, localId, arena);
+
+    using Dist = Length<Weight>;
+    pmr::vector<Dist> dist(size, arena);
+    auto findFurthestNode = [&](int start) {
+        fill(dist.begin(), dist.end(), numeric_limits<Dist>::max());
+        dist[start] = 0;
+        priority_queue<pair<Dist, int>, pmr::vector<pair<Dist, int>>, greater<>> pq{greater<>(), pmr::vector<pair<Dist, int>>(arena)};
+        pq.push({0, start});
+
+        int furthestNode = start;
+        Dist maxDistance = 0;
+
+        while (!pq.empty()) {
+            int u = pq.top().second;
+            Dist d = pq.top().first;
+            pq.pop();
+
+            if (d > dist[u]) continue;
+
+            for (const auto &edge : adjList[u]) {
+                int v = edge.first;
+                Dist weight = edge.second;
+                if (dist[u] + weight < dist[v]) {
+                    dist[v] = dist[u] + weight;
+                    pq.push({dist[v], v});
+                    if (dist[v] > maxDistance) {
+                        maxDistance = dist[v];
+                        furthestNode = v;
+                    }
+                }
+            }
+        }
+        return make_pair(furthestNode, maxDistance);
+    };
+
+    if (size == 0)
+        return 0;
+    int nodeA = findFurthestNode(0).first;
+    return findFurthestNode(nodeA).second;
+}
+
+// Sum of the tree distances over every ordered pair of the component, and the number of pairs.
+// An edge that splits the tree into s and size - s vertices lies on the path of s * (size - s)
+// unordered pairs, so one traversal and the subtree sizes, summed in reverse BFS order, give
+// the total in O(size) rather than one traversal per source.
+template <typename Index, typename Weight>
+pair<double, long long> pairDistancesOf(ComponentEdges<Index, Weight> edges, size_t size, const vector<int> &localId,
+                                        JobControl *control) {
+    if (size < 2)
+        return {0, 0};
+    RequestArena::Scope arenaScope;
+    pmr::memory_resource *arena = RequestArena::resource();
+    auto adjList = treeAdjacency<Index, Weight>(edges, size, localId, arena);
+
+    pmr::vector<int> order(arena);
+    order.reserve(size);
+    pmr::vector<int> parent(size, -1, arena);
+    pmr::vector<Weight> parentWeight(size, arena);
+    parent[0] = 0;
+    order.push_back(0);
+    for (size_t head = 0; head < order.size(); ++head) {
+        int u = order[head];
+        for (const auto &neighbor : adjList[u]) {
+            if (parent[neighbor.first] < 0) {
+                parent[neighbor.first] = u;
+                parentWeight[neighbor.first] = neighbor.second;
+                order.push_back(neighbor.first);
+            }
+        }
+    }
+    jobCheckpoint(control);
+
+    pmr::vector<long long> subtree(size, 1, arena);
+    double totalDistance = 0;
+    for (size_t i = order.size(); i-- > 1;) {
+        int v = order[i];
+        subtree[parent[v]] += subtree[v];
+        totalDistance += static_cast<double>(parentWeight[v]) * static_cast<double>(subtree[v]) *
+                         static_cast<double>(static_cast<long long>(size) - subtree[v]);
+    }
+    jobAdvance(control, size);
+    long long count = static_cast<long long>(size);
+    return {2 * totalDistance, count * (count - 1)};
+}
+
+template <typename Index, typename Weight>
+unique_ptr<ClientGraph> buildIfFits(int vertices, const vector<ClientGraph::EdgeInput> &edges,
+                                    DuplicatePolicy policy) {
+    using Typed = TypedClientGraph<Index, Weight>;
+    if (!Typed::fits(vertices, WeightValue(0LL)))
+        return nullptr;
+    for (const auto &edge : edges) {
+        if (!Typed::fits(vertices, edge.weight))
+            return nullptr;
+    }
+    auto graph = make_unique<Typed>(vertices, policy);
+    for (const auto &edge : edges)
+        graph->addEdge(edge.u, edge.v, edge.weight);
+    return graph;
+}
+
+} // namespace
+
+unique_ptr<ClientGraph> ClientGraph::create(int vertices, const vector<EdgeInput> &edges,
+                                            DuplicatePolicy policy) {
+    if (vertices < 0) {
+        throw runtime_error("Invalid number of vertices");
+    }
+    for (const auto &edge : edges) {
+        if (edge.u < 0 || edge.u >= vertices || edge.v < 0 || edge.v >= vertices)
+            throw runtime_error("Vertex index out of bounds");
+    }
+
+#define TRY_GRAPH_TYPE(Index, Weight)                                        \
+    if (auto graph = buildIfFits<Index, Weight>(vertices, edges, policy))    \
+        return graph;
+    FOR_EACH_GRAPH_TYPE(TRY_GRAPH_TYPE)
+#undef TRY_GRAPH_TYPE
+
+    throw runtime_error("Graph does not fit any supported index/weight type");
+}
+
+unique_ptr<ClientGraph> ClientGraph::fromGraph(const Graph &graph, DuplicatePolicy policy) {
+    vector<EdgeInput> edges;
+    for (const auto &edge : graph.getEdges())
+        edges.push_back({edge.second.first, edge.second.second, WeightValue(static_cast<long long>(edge.first))});
+    return create(graph.getNumVertices(), edges, policy);
+}
+
+template <typename Index, typename Weight>
+TypedClientGraph<Index, Weight>::TypedClientGraph(int vertices, DuplicatePolicy policy) : graph(vertices) {
+    graph.setDuplicatePolicy(policy);
+    countGraph();
+}
+
+template <typename Index, typename Weight>
+bool TypedClientGraph<Index, Weight>::fits(int vertices, const WeightValue &weight) {
+    if (vertices > 0 && static_cast<long long>(vertices - 1) > static_cast<long long>(numeric_limits<Index>::max()))
+        return false;
+    if (is_floating_point_v<Weight>)
+        return true;
+    if (!holds_alternative<long long>(weight))
+        return false;
+    long long value = get<long long>(weight);
+    return value >= static_cast<long long>(numeric_limits<Weight>::lowest()) &&
+           value <= static_cast<long long>(numeric_limits<Weight>::max());
+}
+
+template <typename Index, typename Weight>
+unique_ptr<ClientGraph> TypedClientGraph<Index, Weight>::clone() const {
+    auto copy = make_unique<TypedClientGraph>(0, DuplicatePolicy::ALLOW);
+    copy->graph = graph;
+    // the copy's lists are exact fits; this also recounts what they hold
+    copy->graph.shrinkToFit();
+    copy->countGraph();
+    // a solve or measurement of the shared graph can hold the forest for a long time; the
+    // copy then starts unsolved rather than wait for it
+    unique_lock<mutex> lock(mstMutex, try_to_lock);
+    if (!lock.owns_lock())
+        return copy;
+    copy->mst = mst;
+    copy->mstOffsets = mstOffsets;
+    copy->components = components;
+    copy->solved = solved;
+    copy->countForest();
+    return copy;
+}
+
+template <typename Index, typename Weight>
+string TypedClientGraph<Index, Weight>::getTypeName() const {
+    return string(typeLabel<Index>()) + "/" + typeLabel<Weight>();
+}
+
+template <typename Index, typename Weight>
+DuplicatePolicy TypedClientGraph<Index, Weight>::getDuplicatePolicy() const {
+    return graph.getDuplicatePolicy();
+}
+
+template <typename Index, typename Weight>
+int TypedClientGraph<Index, Weight>::getNumVertices() const {
+    return graph.getNumVertices();
+}
+
+template <typename Index, typename Weight>
+int TypedClientGraph<Index, Weight>::getNumRemovedVertices() const {
+    return graph.getNumRemovedVertices();
+}
+
+template <typename Index, typename Weight>
+bool TypedClientGraph<Index, Weight>::hasVertex(int v) const {
+    return graph.hasVertex(v);
+}
+
+template <typename Index, typename Weight>
+vector<ClientGraph::EdgeInput> TypedClientGraph<Index, Weight>::getEdges() const {
+    vector<EdgeInput> edges;
+    for (const auto &edge : graph.getEdges())
+        edges.push_back({static_cast<int>(edge.second.first), static_cast<int>(edge.second.second), widenWeight(edge.first)});
+    return edges;
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::appendAdjacency(string &out, int first, int last) const {
+    last = min(last, graph.getNumVertices());
+    for (int i = max(first, 0); i < last; ++i) {
+        if (!graph.hasVertex(i))
+            continue;
+        out += "Vertex ";
+        appendNumber(out, i);
+        out += " -> ";
+        for (const auto &edge : graph.getAdjacentEdges(i)) {
+            out += '(';
+            appendNumber(out, edge.first);
+            out += ", ";
+            appendNumber(out, edge.second);
+            out += ") ";
+        }
+        out += '\n';
+    }
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::checkVertex(int v) const {
+    if (v < 0 || v >= graph.getNumVertices()) {
+        throw runtime_error("Vertex index out of bounds");
+    }
+    if (!graph.hasVertex(v)) {
+        throw runtime_error("Vertex " + to_string(v) + " has been removed");
+    }
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::clearMST() {
+    lock_guard<mutex> lock(mstMutex);
+    mst.clear();
+    mstOffsets.clear();
+    solved = false;
+    countForest();
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::countGraph() {
+    graphBytes = graph.getMemoryUsage();
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::countForest() {
+    forestBytes = mst.capacity() * sizeof(typename EdgeList::value_type) + mstOffsets.capacity() * sizeof(size_t) +
+                  (components.componentOf.capacity() + components.vertices.capacity()) * sizeof(int) +
+                  components.offsets.capacity() * sizeof(size_t);
+}
+
+template <typename Index, typename Weight>
+size_t TypedClientGraph<Index, Weight>::trimMemory() {
+    size_t released = graph.shrinkToFit();
+    countGraph();
+    lock_guard<mutex> lock(mstMutex);
+    size_t before = forestBytes;
+    mst.shrink_to_fit();
+    mstOffsets.shrink_to_fit();
+    components.componentOf.shrink_to_fit();
+    components.vertices.shrink_to_fit();
+    components.offsets.shrink_to_fit();
+    countForest();
+    return released + (before - forestBytes);
+}
+
+template <typename Index, typename Weight>
+bool TypedClientGraph<Index, Weight>::addEdge(int u, int v, const WeightValue &weight) {
+    checkVertex(u);
+    checkVertex(v);
+    if (!fits(graph.getNumVertices(), weight))
+        return false;
+    graph.addEdge(static_cast<Index>(u), static_cast<Index>(v), narrowWeight<Weight>(weight));
+    countGraph();
+    return true;
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::removeEdge(int u, int v) {
+    checkVertex(u);
+    checkVertex(v);
+    graph.removeEdge(static_cast<Index>(u), static_cast<Index>(v));
+}
+
+template <typename Index, typename Weight>
+bool TypedClientGraph<Index, Weight>::addVertex(int newVertex) {
+    if (newVertex < 0) {
+        throw runtime_error("Vertex index out of bounds");
+    }
+    if (!fits(max(newVertex + 1, graph.getNumVertices()), WeightValue(0LL)))
+        return false;
+    graph.addVertex(newVertex);
+    countGraph();
+    return true;
+}
+
+template <typename Index, typename Weight>
+int TypedClientGraph<Index, Weight>::addVertex() {
+    if (graph.getNumRemovedVertices() == 0 && !fits(graph.getNumVertices() + 1, WeightValue(0LL)))
+        return -1;
+    int vertex = graph.addVertex();
+    countGraph();
+    return vertex;
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::removeVertex(int vertexToRemove) {
+    checkVertex(vertexToRemove);
+    graph.removeVertex(vertexToRemove);
+    countGraph();
+    // the stored forest still spans the removed vertex
+    clearMST();
+}
+
+template <typename Index, typename Weight>
+vector<int> TypedClientGraph<Index, Weight>::compact() {
+    clearMST();
+    vector<int> newId = graph.compact();
+    countGraph();
+    return newId;
+}
+
+// Each component is solved on its own, in parallel: a connected graph is solved in place,
+// otherwise every component with edges is copied into a local-id subgraph first
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::solveForest(const string &strategyName, ThreadPoll &pool, JobControl *control) {
+    BasicConcreteStrategyFactory<Index, Weight> factory;
+    // strategies keep no state, so the workers share one
+    auto strategy = factory.createStrategy(strategyName);
+
+    // everything is built aside and stored at the end, so a cancelled solve keeps the last MST
+    Components found = findComponents(graph, pool);
+    jobCheckpoint(control);
+    size_t count = found.count();
+    // removed vertices leave holes a strategy would treat as isolated vertices
+    if (count <= 1 && graph.getNumRemovedVertices() == 0) {
+        mst = strategy->computeMST(graph, control);
+        mstOffsets = {0, mst.size()};
+        components = move(found);
+        solved = true;
+        return;
+    }
+
+    vector<EdgeList> forest(count);
+    vector<int> localId(graph.getNumVertices());
+    pool.parallelFor(count, [&](size_t c) {
+        size_t size = found.size(c);
+        if (size < 2)
+            return;
+        jobCheckpoint(control);
+        const int *members = &found.vertices[found.offsets[c]];
+        for (size_t i = 0; i < size; ++i)
+            localId[members[i]] = static_cast<int>(i);
+
+        GraphType component(static_cast<int>(size));
+        for (size_t i = 0; i < size; ++i) {
+            for (const auto &edge : graph.getAdjacentEdges(members[i])) {
+                int j = localId[edge.first];
+                if (static_cast<int>(i) < j)
+                    component.addEdge(static_cast<Index>(i), static_cast<Index>(j), edge.second);
+            }
+        }
+
+        EdgeList tree = strategy->computeMST(component, control);
+        for (auto &edge : tree)
+            edge.second = {static_cast<Index>(members[edge.second.first]), static_cast<Index>(members[edge.second.second])};
+        forest[c] = move(tree);
+    });
+
+    mst.clear();
+    mstOffsets.assign(1, 0);
+    for (auto &tree : forest) {
+        mst.insert(mst.end(), tree.begin(), tree.end());
+        mstOffsets.push_back(mst.size());
+    }
+    components = move(found);
+    solved = true;
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::solveMST(const string &strategyName, ThreadPoll &pool, JobControl *control) {
+    lock_guard<mutex> lock(mstMutex);
+    solveForest(strategyName, pool, control);
+    countForest();
+}
+
+template <typename Index, typename Weight>
+MSTMeasurements TypedClientGraph<Index, Weight>::measure(ThreadPoll &pool, JobControl *control) const {
+    lock_guard<mutex> lock(mstMutex);
+    return measureForest(pool, control);
+}
+
+template <typename Index, typename Weight>
+MSTMeasurements TypedClientGraph<Index, Weight>::solveAndMeasure(const string &strategyName, ThreadPoll &pool,
+                                                                 JobControl *control) {
+    lock_guard<mutex> lock(mstMutex);
+    if (control)
+        control->startPhase("solving");
+    solveForest(strategyName, pool, control);
+    countForest();
+    if (control)
+        control->startPhase("measuring");
+    return measureForest(pool, control);
+}
+
+template <typename Index, typename Weight>
+bool TypedClientGraph<Index, Weight>::hasMST() const {
+    lock_guard<mutex> lock(mstMutex);
+    return solved;
+}
+
+template <typename Index, typename Weight>
+size_t TypedClientGraph<Index, Weight>::getComponentCount() const {
+    lock_guard<mutex> lock(mstMutex);
+    return solved ? components.count() : 0;
+}
+
+template <typename Index, typename Weight>
+vector<ClientGraph::EdgeInput> TypedClientGraph<Index, Weight>::getForest() const {
+    lock_guard<mutex> lock(mstMutex);
+    vector<EdgeInput> forest;
+    forest.reserve(mst.size());
+    for (const auto &edge : mst)
+        forest.push_back({static_cast<int>(edge.second.first), static_cast<int>(edge.second.second), widenWeight(edge.first)});
+    return forest;
+}
+
+// The forest edges are grouped by the component of their first endpoint, as solveForest does
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::restoreForest(const vector<EdgeInput> &forest, ThreadPoll &pool) {
+    Components found = findComponents(graph, pool);
+    vector<size_t> offsets(found.count() + 1, 0);
+    for (const auto &edge : forest) {
+        checkVertex(edge.u);
+        ++offsets[found.componentOf[edge.u] + 1];
+    }
+    for (size_t c = 0; c < found.count(); ++c)
+        offsets[c + 1] += offsets[c];
+
+    EdgeList grouped(forest.size());
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (const auto &edge : forest)
+        grouped[next[found.componentOf[edge.u]]++] = {narrowWeight<Weight>(edge.weight),
+                                                      {static_cast<Index>(edge.u), static_cast<Index>(edge.v)}};
+
+    lock_guard<mutex> lock(mstMutex);
+    mst = move(grouped);
+    mstOffsets = move(offsets);
+    components = move(found);
+    solved = true;
+    countForest();
+}
+
+// Every stage runs over the components in parallel; the aggregate sums the totals, takes the
+// largest diameter and the shortest edge, and averages over all connected pairs
+template <typename Index, typename Weight>
+MSTMeasurements TypedClientGraph<Index, Weight>::measureForest(ThreadPoll &pool, JobControl *control) const {
+    if (!solved) {
+        throw runtime_error("MST result not found");
+    }
+    size_t count = components.count();
+    auto edgesOf = [this](size_t c) {
+        return ComponentEdges<Index, Weight>{mst.data() + mstOffsets[c], mst.data() + mstOffsets[c + 1]};
+    };
+
+    vector<int> localId(graph.getNumVertices());
+    pool.parallelFor(count, [&](size_t c) {
+        for (size_t i = components.offsets[c]; i < components.offsets[c + 1]; ++i)
+            localId[components.vertices[i]] = static_cast<int>(i - components.offsets[c]);
+    });
+
+    // progress follows the average-distance stage, one unit per vertex
+    if (control)
+        control->addWork(components.vertices.size());
+    vector<WeightSummary<Weight>> summaries(count);
+    vector<Length<Weight>> diameters(count);
+    vector<pair<double, long long>> pairDistances(count);
+    {
+        ScopedTimer timer(Metrics::STAGE_TOTAL_WEIGHT);
+        pool.parallelFor(count, [&](size_t c) { summaries[c] = summaryOf(edgesOf(c)); });
+    }
+    {
+        ScopedTimer timer(Metrics::STAGE_LONGEST_DISTANCE);
+        pool.parallelFor(count, [&](size_t c) {
+            diameters[c] = longestDistanceOf(edgesOf(c), components.size(c), localId);
+        });
+    }
+    jobCheckpoint(control);
+    {
+        ScopedTimer timer(Metrics::STAGE_AVERAGE_DISTANCE);
+        pool.parallelFor(count, [&](size_t c) {
+            pairDistances[c] = pairDistancesOf(edgesOf(c), components.size(c), localId, control);
+        });
+    }
+
+    MSTMeasurements result;
+    result.components.resize(count);
+    Length<Weight> total = 0, longest = 0;
+    double distanceSum = 0;
+    long long pairCount = 0;
+    bool anyEdge = false;
+    Weight shortest = Weight();
+    {
+        ScopedTimer timer(Metrics::STAGE_SHORTEST_DISTANCE);
+        for (size_t c = 0; c < count; ++c) {
+            ComponentMeasurements &component = result.components[c];
+            component.vertices = static_cast<int>(components.size(c));
+            component.edges = mstOffsets[c + 1] - mstOffsets[c];
+            component.totalWeight = widenWeight(summaries[c].sum);
+            component.longestDistance = widenWeight(diameters[c]);
+            component.averageDistance = pairDistances[c].second ? pairDistances[c].first / pairDistances[c].second : 0;
+            component.shortestMSTDistance = widenWeight(Weight());
+            if (component.edges > 0) {
+                Weight edge = summaries[c].min;
+                component.shortestMSTDistance = widenWeight(edge);
+                shortest = anyEdge ? min(shortest, edge) : edge;
+                anyEdge = true;
+            }
+
+            total += summaries[c].sum;
+            longest = max(longest, diameters[c]);
+            distanceSum += pairDistances[c].first;
+            pairCount += pairDistances[c].second;
+        }
+    }
+
+    if (pairCount == 0) {
+        throw runtime_error("No valid pairs found in MST");
+    }
+    if (!anyEdge) {
+        throw runtime_error("MST has no edges");
+    }
+    result.totalWeight = widenWeight(total);
+    result.longestDistance = widenWeight(longest);
+    result.averageDistance = distanceSum / pairCount;
+    result.shortestMSTDistance = widenWeight(shortest);
+    return result;
+}
+
+template <typename Index, typename Weight>
+vector<int> TypedClientGraph<Index, Weight>::findPath(int source, int target, ThreadPoll &pool) const {
+    checkVertex(target);
+    return graph.buildSpanningTree(source, pool).getPath(target);
+}
+
+template <typename Index, typename Weight>
+void TypedClientGraph<Index, Weight>::visualize(bool withMST) const {
+    // the window stays open for a while, so draw a copy rather than hold the lock
+    EdgeList shown;
+    bool withTree = false;
+    {
+        lock_guard<mutex> lock(mstMutex);
+        withTree = withMST && solved;
+        if (withTree)
+            shown = mst;
+    }
+    GraphVisualizer visualizer(&graph, withTree ? &shown : nullptr);
+    visualizer.run();
+}
+
+#define INSTANTIATE_CLIENT_GRAPH(Index, Weight) template class TypedClientGraph<Index, Weight>;
+FOR_EACH_GRAPH_TYPE(INSTANTIATE_CLIENT_GRAPH)
+#undef INSTANTIATE_CLIENT_GRAPH
@@ -0,0 +1,200 @@
+#ifndef CLIENT_GRAPH_HPP
+#define CLIENT_GRAPH_HPP
+
+#include "Graph.hpp"
+#include "MST.hpp"
+#include "Components.hpp"
+#include "ThreadPoll.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Measurements of one tree of the spanning forest. A single vertex has no pairs and no edges,
+// so its average and shortest distance are reported as 0.
+struct ComponentMeasurements
+{
+    int vertices = 0;
+    size_t edges = 0;
+    WeightValue totalWeight;
+    WeightValue longestDistance;
+    double averageDistance = 0;
+    WeightValue shortestMSTDistance;
+};
+
+// Measurements of a client's minimum spanning forest, widened from the graph's weight type.
+// The aggregate sums the tree weights, takes the largest diameter and the shortest edge, and
+// averages the distance over all pairs of vertices that share a component.
+struct MSTMeasurements
+{
+    WeightValue totalWeight;
+    WeightValue longestDistance;
+    double averageDistance = 0;
+    WeightValue shortestMSTDistance;
+    // one entry per connected component, in the order of their smallest vertex
+    vector<ComponentMeasurements> components;
+};
+
+// Heap bytes held by a client graph: the graph's storage and its solved forest
+struct GraphMemoryUsage
+{
+    size_t graph = 0;
+    size_t forest = 0;
+
+    size_t total() const { return graph + forest; }
+};
+
+//This class holds one client's graph and its last minimum spanning forest (one tree per
+//connected component) without exposing which BasicGraph instantiation stores them.
+//create() picks the narrowest instantiation that holds every vertex id and weight once,
+//when the graph is loaded; solving and measuring then run directly on that storage.
+//An edit that no longer fits is refused with false, and the server re-creates the graph
+//in a wider instantiation. A published graph is shared by every session attached to it and
+//never edited again; the server clones it for a session that wants to change it.
+class ClientGraph
+{
+public:
+    struct EdgeInput
+    {
+        int u, v;
+        WeightValue weight;
+    };
+
+    // With a policy other than ALLOW, duplicate pairs in edges are merged by it (REJECT throws)
+    static unique_ptr<ClientGraph> create(int vertices, const vector<EdgeInput> &edges,
+                                          DuplicatePolicy policy = DuplicatePolicy::ALLOW);
+    static unique_ptr<ClientGraph> fromGraph(const Graph &graph, DuplicatePolicy policy = DuplicatePolicy::ALLOW);
+    virtual ~ClientGraph() = default;
+
+    // Copies the graph, and its MST unless a solve is using it, into a private unpublished graph
+    virtual unique_ptr<ClientGraph> clone() const = 0;
+    void markPublished() { published = true; }
+    bool isPublished() const { return published; }
+
+    // e.g. "uint16/uint16" (index/weight), for logs and diagnostics
+    virtual string getTypeName() const = 0;
+    virtual DuplicatePolicy getDuplicatePolicy() const = 0;
+    // Size of the vertex id space; removed ids stay in it until compact()
+    virtual int getNumVertices() const = 0;
+    virtual int getNumRemovedVertices() const = 0;
+    virtual bool hasVertex(int v) const = 0;
+    virtual vector<EdgeInput> getEdges() const = 0;
+    // Appends "Vertex i -> (v, w) ..." lines for the live vertices in [first, last)
+    virtual void appendAdjacency(string &out, int first, int last) const = 0;
+
+    // graph operations; false means the id or weight needs a wider instantiation
+    virtual bool addEdge(int u, int v, const WeightValue &weight) = 0;
+    virtual void removeEdge(int u, int v) = 0;
+    virtual bool addVertex(int newVertex) = 0;
+    // Reuses a removed id or appends one; -1 means appending needs a wider instantiation
+    virtual int addVertex() = 0;
+    virtual void removeVertex(int vertexToRemove) = 0;
+    // Renumbers the live vertices densely and drops the MST; see BasicGraph::compact
+    virtual vector<int> compact() = 0;
+
+    // Spanning forest of the current graph; components are found and solved in parallel on
+    // the pool. measure() needs a solved forest. With a JobControl both report progress and
+    // throw JobCancelled once it is cancelled; a cancelled solve keeps the previous forest.
+    virtual void solveMST(const string &strategyName, ThreadPoll &pool, JobControl *control = nullptr) = 0;
+    virtual bool hasMST() const = 0;
+    virtual size_t getComponentCount() const = 0;
+    // The stored forest as edges (empty when unsolved). restoreForest installs a forest that
+    // was solved elsewhere on an identical graph, e.g. by another worker process.
+    virtual vector<EdgeInput> getForest() const = 0;
+    virtual void restoreForest(const vector<EdgeInput> &forest, ThreadPoll &pool) = 0;
+    virtual MSTMeasurements measure(ThreadPoll &pool, JobControl *control = nullptr) const = 0;
+    // Both in one turn on the stored forest, so another solve of a shared graph cannot slip
+    // in between; this is what asynchronous jobs run
+    virtual MSTMeasurements solveAndMeasure(const string &strategyName, ThreadPoll &pool,
+                                            JobControl *control = nullptr) = 0;
+
+    // Fewest-hop path source ... target through a parallel BFS tree; empty when unreachable
+    virtual vector<int> findPath(int source, int target, ThreadPoll &pool) const = 0;
+
+    // Opens the SFML window; blocks until it is closed
+    virtual void visualize(bool withMST) const = 0;
+
+    // Refreshed by every edit and solve, so any thread may read it while the owner works
+    GraphMemoryUsage getMemoryUsage() const { return {graphBytes.load(), forestBytes.load()}; }
+    // Releases capacity that growth and removals left unused; the caller makes sure nobody
+    // else uses the graph meanwhile. Returns the bytes released.
+    virtual size_t trimMemory() = 0;
+
+protected:
+    atomic<size_t> graphBytes{0};
+    atomic<size_t> forestBytes{0};
+
+private:
+    atomic<bool> published{false};
+};
+
+template <typename Index, typename Weight>
+class TypedClientGraph : public ClientGraph
+{
+public:
+    using GraphType = BasicGraph<Index, Weight>;
+    using EdgeList = typename BasicMST<Index, Weight>::EdgeList;
+
+    TypedClientGraph(int vertices, DuplicatePolicy policy);
+
+    static bool fits(int vertices, const WeightValue &weight);
+
+    unique_ptr<ClientGraph> clone() const override;
+
+    string getTypeName() const override;
+    DuplicatePolicy getDuplicatePolicy() const override;
+    int getNumVertices() const override;
+    int getNumRemovedVertices() const override;
+    bool hasVertex(int v) const override;
+    vector<EdgeInput> getEdges() const override;
+    void appendAdjacency(string &out, int first, int last) const override;
+
+    bool addEdge(int u, int v, const WeightValue &weight) override;
+    void removeEdge(int u, int v) override;
+    bool addVertex(int newVertex) override;
+    int addVertex() override;
+    void removeVertex(int vertexToRemove) override;
+    vector<int> compact() override;
+
+    void solveMST(const string &strategyName, ThreadPoll &pool, JobControl *control) override;
+    bool hasMST() const override;
+    size_t getComponentCount() const override;
+    vector<EdgeInput> getForest() const override;
+    void restoreForest(const vector<EdgeInput> &forest, ThreadPoll &pool) override;
+    MSTMeasurements measure(ThreadPoll &pool, JobControl *control) const override;
+    MSTMeasurements solveAndMeasure(const string &strategyName, ThreadPoll &pool, JobControl *control) override;
+
+    vector<int> findPath(int source, int target, ThreadPoll &pool) const override;
+
+    void visualize(bool withMST) const override;
+
+    size_t trimMemory() override;
+
+private:
+    GraphType graph;
+    // forest edges grouped by component: component c owns mst[mstOffsets[c] .. mstOffsets[c + 1])
+    EdgeList mst;
+    vector<size_t> mstOffsets;
+    Components components;
+    bool solved = false;
+    // Sessions attached to a published graph share its MST; solves and reads of it take turns
+    mutable mutex mstMutex;
+
+    void checkVertex(int v) const;
+    void clearMST();
+    // Refresh graphBytes / forestBytes; countForest needs mstMutex or a fresh copy
+    void countGraph();
+    void countForest();
+    // solveMST and measure without taking mstMutex
+    void solveForest(const string &strategyName, ThreadPoll &pool, JobControl *control);
+    MSTMeasurements measureForest(ThreadPoll &pool, JobControl *control) const;
+};
+
+#define DECLARE_CLIENT_GRAPH(Index, Weight) extern template class TypedClientGraph<Index, Weight>;
+FOR_EACH_GRAPH_TYPE(DECLARE_CLIENT_GRAPH)
+#undef DECLARE_CLIENT_GRAPH
+
+#endif // CLIENT_GRAPH_HPP
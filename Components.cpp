@@ -0,0 +1,113 @@
+#include "Components.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+namespace {
+
+const size_t BLOCK_SIZE = 4096;
+
+// Roots only ever move to smaller vertex ids, so every root ends up as its component's minimum
+class AtomicUnionFind {
+public:
+    explicit AtomicUnionFind(int n) : parent(make_unique<atomic<int>[]>(n)) {
+        for (int i = 0; i < n; ++i)
+            parent[i].store(i, memory_order_relaxed);
+    }
+
+    int find(int x) {
+        while (true) {
+            int p = parent[x].load(memory_order_acquire);
+            if (p == x)
+                return x;
+            int grandparent = parent[p].load(memory_order_acquire);
+            // path halving; losing the race only means less compression
+            if (grandparent != p)
+                parent[x].compare_exchange_weak(p, grandparent, memory_order_acq_rel);
+            x = grandparent;
+        }
+    }
+
+    void unite(int a, int b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return;
+            if (a < b)
+                swap(a, b);
+            int expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, memory_order_acq_rel))
+                return;
+        }
+    }
+
+private:
+    unique_ptr<atomic<int>[]> parent;
+};
+
+} // namespace
+
+template <typename Index, typename Weight>
+Components findComponents(const BasicGraph<Index, Weight> &graph, ThreadPoll &pool) {
+    int V = graph.getNumVertices();
+    size_t blocks = (V + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    auto blockRange = [V](size_t block) {
+        int begin = static_cast<int>(block * BLOCK_SIZE);
+        return make_pair(begin, min(V, begin + static_cast<int>(BLOCK_SIZE)));
+    };
+
+    AtomicUnionFind sets(V);
+    pool.parallelFor(blocks, [&](size_t block) {
+        auto [begin, end] = blockRange(block);
+        for (int u = begin; u < end; ++u) {
+            for (const auto &edge : graph.getAdjacentEdges(u)) {
+                int v = static_cast<int>(edge.first);
+                if (u < v)
+                    sets.unite(u, v);
+            }
+        }
+    });
+
+    Components result;
+    result.componentOf.resize(V);
+    pool.parallelFor(blocks, [&](size_t block) {
+        auto [begin, end] = blockRange(block);
+        for (int u = begin; u < end; ++u)
+            result.componentOf[u] = sets.find(u);
+    });
+
+    // Roots are component minimums, so one ascending pass numbers them in order
+    result.offsets.push_back(0);
+    for (int u = 0; u < V; ++u) {
+        if (!graph.hasVertex(u)) {
+            result.componentOf[u] = -1;
+            continue;
+        }
+        int root = result.componentOf[u];
+        if (root == u) {
+            result.componentOf[u] = static_cast<int>(result.offsets.size() - 1);
+            result.offsets.push_back(0);
+        }
+        else {
+            result.componentOf[u] = result.componentOf[root];
+        }
+        ++result.offsets[result.componentOf[u] + 1];
+    }
+    for (size_t c = 1; c < result.offsets.size(); ++c)
+        result.offsets[c] += result.offsets[c - 1];
+
+    result.vertices.resize(result.offsets.back());
+    vector<size_t> fill(result.offsets.begin(), result.offsets.end() - 1);
+    for (int u = 0; u < V; ++u)
+        if (result.componentOf[u] >= 0)
+            result.vertices[fill[result.componentOf[u]]++] = u;
+    return result;
+}
+
+#define INSTANTIATE_FIND_COMPONENTS(Index, Weight) \
+    template Components findComponents(const BasicGraph<Index, Weight> &, ThreadPoll &);
+FOR_EACH_GRAPH_TYPE(INSTANTIATE_FIND_COMPONENTS)
+#undef INSTANTIATE_FIND_COMPONENTS
@@ -0,0 +1,33 @@
+#ifndef COMPONENTS_HPP
+#define COMPONENTS_HPP
+
+#include "Graph.hpp"
+#include "ThreadPoll.hpp"
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// Connected components of a graph. Components are numbered in the order of their smallest
+// vertex; the vertices of component c are vertices[offsets[c]] .. vertices[offsets[c + 1] - 1]
+// in increasing order. Removed vertices belong to no component (componentOf is -1).
+struct Components
+{
+    vector<int> componentOf;
+    vector<int> vertices;
+    vector<size_t> offsets;
+
+    size_t count() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t size(size_t c) const { return offsets[c + 1] - offsets[c]; }
+};
+
+// Lock-free union-find over the adjacency lists, split into vertex blocks across the pool
+template <typename Index, typename Weight>
+Components findComponents(const BasicGraph<Index, Weight> &graph, ThreadPoll &pool);
+
+#define DECLARE_FIND_COMPONENTS(Index, Weight) \
+    extern template Components findComponents(const BasicGraph<Index, Weight> &, ThreadPoll &);
+FOR_EACH_GRAPH_TYPE(DECLARE_FIND_COMPONENTS)
+#undef DECLARE_FIND_COMPONENTS
+
+#endif // COMPONENTS_HPP
@@ -0,0 +1,173 @@
+#include "Connection.hpp"
+#include "Logger.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char PROMPT[] = "\n> ";
+
+} // namespace
+
+Connection::Connection(int socket_fd, Scheduler &scheduler) : socket_fd(socket_fd), scheduler(scheduler) {
+    fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+    scheduler.add(socket_fd);
+}
+
+Connection::~Connection() {
+    scheduler.remove(socket_fd);
+}
+
+// Only the bytes appended since the last call are searched, so a long line costs one pass
+int Connection::fill() {
+    while (true) {
+        size_t newline = pending.find('\n', scanned);
+        if (newline != string::npos) {
+            scanned = newline;
+            return 1;
+        }
+        scanned = pending.size();
+        if (pending.size() > MAX_LINE_LENGTH) {
+            LOG_WARN("Line longer than %zu bytes on fd %d, closing the connection", MAX_LINE_LENGTH, socket_fd);
+            return 0;
+        }
+        char buffer[4096];
+        ssize_t valread = read(socket_fd, buffer, sizeof(buffer));
+        if (valread < 0 && errno == EINTR)
+            continue;
+        if (valread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return -1;
+        if (valread <= 0)
+            return 0;
+        Metrics::add(Metrics::BYTES_IN, valread);
+        pending.append(buffer, valread);
+    }
+}
+
+Connection::ReadLine::ReadLine(Connection &conn, string &line) : conn(conn), line(line) {}
+
+bool Connection::ReadLine::await_ready() {
+    status = conn.fill();
+    return status >= 0;
+}
+
+void Connection::ReadLine::await_suspend(coroutine_handle<> handle) {
+    waiting = handle;
+    conn.scheduler.wait(conn.socket_fd, EPOLLIN, this);
+}
+
+void Connection::ReadLine::ready() {
+    status = conn.fill();
+    if (status < 0)
+        conn.scheduler.wait(conn.socket_fd, EPOLLIN, this);
+    else
+        waiting.resume();
+}
+
+bool Connection::ReadLine::await_resume() {
+    if (status == 0)
+        return false;
+    line.assign(conn.pending, 0, conn.scanned);
+    conn.pending.erase(0, conn.scanned + 1);
+    conn.scanned = 0;
+    return true;
+}
+
+Connection::Send::Send(Connection &conn, const string *body, string ownedBody, bool withPrompt)
+    : conn(conn), owned(move(ownedBody)), count(withPrompt ? 2 : 1), timer(Metrics::STAGE_SEND) {
+    if (!body)
+        body = &owned;
+    iov[0] = {const_cast<char *>(body->data()), body->size()};
+    iov[1] = {const_cast<char *>(PROMPT), sizeof(PROMPT) - 1};
+}
+
+// sendmsg until every buffer is out; a partial write advances past the bytes already sent
+int Connection::Send::tryWrite() {
+    int first = 0;
+    while (first < count) {
+        if (iov[first].iov_len == 0) {
+            ++first;
+            continue;
+        }
+        msghdr msg = {};
+        msg.msg_iov = iov + first;
+        msg.msg_iovlen = count - first;
+        ssize_t n = sendmsg(conn.socket_fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return -1;
+        if (n <= 0)
+            return 0;
+        sent += n;
+        size_t left = n;
+        while (first < count && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            iov[first].iov_len = 0;
+            ++first;
+        }
+        if (first < count) {
+            iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    Metrics::add(Metrics::BYTES_OUT, sent);
+    return 1;
+}
+
+bool Connection::Send::await_ready() {
+    status = tryWrite();
+    return status >= 0;
+}
+
+void Connection::Send::await_suspend(coroutine_handle<> handle) {
+    waiting = handle;
+    conn.scheduler.wait(conn.socket_fd, EPOLLOUT, this);
+}
+
+void Connection::Send::ready() {
+    status = tryWrite();
+    if (status < 0)
+        conn.scheduler.wait(conn.socket_fd, EPOLLOUT, this);
+    else
+        waiting.resume();
+}
+
+bool Connection::Send::await_resume() {
+    return status == 1;
+}
+
+Connection::ReadLine Connection::readLine(string &line) {
+    return ReadLine(*this, line);
+}
+
+Connection::Send Connection::sendAll(string message) {
+    return Send(*this, nullptr, move(message), false);
+}
+
+Connection::Send Connection::sendResponse(const string &body) {
+    return Send(*this, &body, string(), true);
+}
+
+Connection::Send Connection::sendResponse(string &&body) {
+    return Send(*this, nullptr, move(body), true);
+}
+
+string &Connection::responseBuffer() {
+    response.clear();
+    return response;
+}
+
+void Connection::releaseResponseBuffer() {
+    if (response.capacity() > MAX_KEPT_BUFFER)
+        string().swap(response);
+}
+
+int Connection::getSocket() const {
+    return socket_fd;
+}
@@ -0,0 +1,102 @@
+#ifndef CONNECTION_HPP
+#define CONNECTION_HPP
+
+#include "Metrics.hpp"
+#include "Scheduler.hpp"
+#include <coroutine>
+#include <string>
+#include <sys/uio.h>
+
+using namespace std;
+
+//This class wraps a non-blocking client socket for a session coroutine. It splits the
+//incoming byte stream into lines, so pipelined commands that arrive in a single read() are
+//not merged together, and its reads and writes are awaitables that suspend the session on
+//the scheduler instead of blocking a thread:
+//    if (!co_await conn.readLine(line)) ...
+//    co_await conn.sendResponse(body);
+class Connection {
+public:
+    // A client whose line grows past this without a '\n' is disconnected; a batch graph line
+    // is the longest a client legitimately sends
+    static constexpr size_t MAX_LINE_LENGTH = 1 << 20;
+
+    Connection(int socket_fd, Scheduler &scheduler);
+    ~Connection();
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    // Awaits the next '\n'-terminated line (without the terminator); false on disconnect or
+    // when the line passes MAX_LINE_LENGTH
+    class ReadLine : public Scheduler::Waiter {
+    public:
+        ReadLine(Connection &conn, string &line);
+        bool await_ready();
+        void await_suspend(coroutine_handle<> handle);
+        bool await_resume();
+        void ready() override;
+
+    private:
+        Connection &conn;
+        string &line;
+        coroutine_handle<> waiting;
+        // 1 = line available, 0 = disconnected, -1 = would block
+        int status = -1;
+    };
+
+    // Awaits a gather write of up to two buffers, resumed after partial writes; false if the
+    // peer is gone. Borrowed buffers must outlive the co_await.
+    class Send : public Scheduler::Waiter {
+    public:
+        Send(Connection &conn, const string *body, string owned, bool withPrompt);
+        Send(const Send &) = delete;
+        Send &operator=(const Send &) = delete;
+        bool await_ready();
+        void await_suspend(coroutine_handle<> handle);
+        bool await_resume();
+        void ready() override;
+
+    private:
+        Connection &conn;
+        string owned;
+        iovec iov[2];
+        int count;
+        size_t sent = 0;
+        coroutine_handle<> waiting;
+        int status = -1;
+        ScopedTimer timer;
+
+        int tryWrite();
+    };
+
+    ReadLine readLine(string &line);
+    // The whole message, as is
+    Send sendAll(string message);
+    // body followed by the "\n> " prompt, without joining them; the const& overload
+    // borrows body (e.g. the response buffer), the other one keeps it
+    Send sendResponse(const string &body);
+    Send sendResponse(string &&body);
+
+    // Per-connection buffer for assembling large responses (see dump); cleared before use,
+    // it keeps its capacity between responses unless it grew past MAX_KEPT_BUFFER
+    string &responseBuffer();
+    void releaseResponseBuffer();
+
+    int getSocket() const;
+
+private:
+    static constexpr size_t MAX_KEPT_BUFFER = 1 << 20;
+
+    int socket_fd;
+    Scheduler &scheduler;
+    string pending;
+    // pending[0 .. scanned) holds no '\n'; once fill() finds one, scanned is its position
+    size_t scanned = 0;
+    string response;
+
+    // Reads what the socket has until a full line is pending; same codes as ReadLine::status
+    int fill();
+};
+
+#endif // CONNECTION_HPP
@@ -0,0 +1,148 @@
+#include "EdgeIndex.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+const size_t INITIAL_SLOTS = 16;
+
+// splitmix64 finalizer: spreads the packed (u, v) pair over all bits
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+DuplicatePolicy parseDuplicatePolicy(const string &name) {
+    if (name == "allow")
+        return DuplicatePolicy::ALLOW;
+    if (name == "keep_min")
+        return DuplicatePolicy::KEEP_MIN;
+    if (name == "replace")
+        return DuplicatePolicy::REPLACE;
+    if (name == "reject")
+        return DuplicatePolicy::REJECT;
+    throw runtime_error("Unknown duplicate edge policy: " + name);
+}
+
+EdgeIndex::EdgeIndex() : count(0) {}
+
+uint64_t EdgeIndex::makeKey(int u, int v) {
+    uint32_t low = static_cast<uint32_t>(min(u, v));
+    uint32_t high = static_cast<uint32_t>(max(u, v));
+    return (static_cast<uint64_t>(low) << 32) | high;
+}
+
+// Slot holding key, or the empty slot where it would go
+size_t EdgeIndex::slotOf(uint64_t key) const {
+    size_t mask = keys.size() - 1;
+    size_t slot = mix(key) & mask;
+    while (keys[slot] != EMPTY && keys[slot] != key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+EdgeIndex::Positions *EdgeIndex::find(int u, int v) {
+    if (count == 0)
+        return nullptr;
+    size_t slot = slotOf(makeKey(u, v));
+    return keys[slot] == EMPTY ? nullptr : &values[slot];
+}
+
+const EdgeIndex::Positions *EdgeIndex::find(int u, int v) const {
+    if (count == 0)
+        return nullptr;
+    size_t slot = slotOf(makeKey(u, v));
+    return keys[slot] == EMPTY ? nullptr : &values[slot];
+}
+
+void EdgeIndex::insert(int u, int v, Positions positions) {
+    // keep the load factor at or below 1/2 so probe runs stay short
+    if ((count + 1) * 2 > keys.size())
+        grow();
+    uint64_t key = makeKey(u, v);
+    size_t slot = slotOf(key);
+    if (keys[slot] == EMPTY)
+        ++count;
+    keys[slot] = key;
+    values[slot] = positions;
+}
+
+bool EdgeIndex::erase(int u, int v) {
+    if (count == 0)
+        return false;
+    size_t mask = keys.size() - 1;
+    size_t hole = slotOf(makeKey(u, v));
+    if (keys[hole] == EMPTY)
+        return false;
+
+    // shift later members of the probe run back so lookups never stop early at the hole
+    for (size_t next = (hole + 1) & mask; keys[next] != EMPTY; next = (next + 1) & mask) {
+        size_t home = mix(keys[next]) & mask;
+        // move the entry unless its home lies cyclically in (hole, next]
+        bool between = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!between) {
+            keys[hole] = keys[next];
+            values[hole] = values[next];
+            hole = next;
+        }
+    }
+    keys[hole] = EMPTY;
+    --count;
+    return true;
+}
+
+void EdgeIndex::clear() {
+    vector<uint64_t>().swap(keys);
+    vector<Positions>().swap(values);
+    count = 0;
+}
+
+size_t EdgeIndex::size() const {
+    return count;
+}
+
+size_t EdgeIndex::getMemoryUsage() const {
+    return keys.capacity() * sizeof(uint64_t) + values.capacity() * sizeof(Positions);
+}
+
+uint32_t &EdgeIndex::positionIn(Positions &positions, int from, int to) {
+    return from < to ? positions.inLower : positions.inHigher;
+}
+
+void EdgeIndex::shrinkToFit() {
+    if (count == 0) {
+        clear();
+        return;
+    }
+    size_t slots = INITIAL_SLOTS;
+    while (count * 2 > slots)
+        slots *= 2;
+    if (slots < keys.size())
+        rehash(slots);
+}
+
+void EdgeIndex::grow() {
+    rehash(max(INITIAL_SLOTS, keys.size() * 2));
+}
+
+void EdgeIndex::rehash(size_t slots) {
+    vector<uint64_t> oldKeys(slots, EMPTY);
+    vector<Positions> oldValues(slots);
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+    for (size_t i = 0; i < oldKeys.size(); ++i) {
+        if (oldKeys[i] == EMPTY)
+            continue;
+        size_t slot = slotOf(oldKeys[i]);
+        keys[slot] = oldKeys[i];
+        values[slot] = oldValues[i];
+    }
+}
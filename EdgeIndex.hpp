@@ -0,0 +1,67 @@
+#ifndef EDGE_INDEX_HPP
+#define EDGE_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// What addEdge does with a second edge between the same two vertices.
+// ALLOW keeps parallel edges and uses no index; the other policies index every edge.
+enum class DuplicatePolicy
+{
+    ALLOW,
+    KEEP_MIN,
+    REPLACE,
+    REJECT
+};
+
+// "allow", "keep_min", "replace" or "reject"; throws on anything else
+DuplicatePolicy parseDuplicatePolicy(const string &name);
+
+//This class maps an undirected edge {u, v} to where it sits in both adjacency lists, so a
+//graph can find, reweight and remove an edge in O(1) expected time. It is a flat
+//open-addressing table with linear probing and backward-shift deletion (no tombstones);
+//it allocates nothing until the first insert.
+class EdgeIndex
+{
+public:
+    // Position of the larger endpoint in the smaller one's list, and the other way around
+    struct Positions
+    {
+        uint32_t inLower;
+        uint32_t inHigher;
+    };
+
+    EdgeIndex();
+
+    // nullptr when {u, v} is not indexed; invalidated by insert and erase
+    Positions *find(int u, int v);
+    const Positions *find(int u, int v) const;
+    void insert(int u, int v, Positions positions);
+    bool erase(int u, int v);
+    void clear();
+    // Rehashes into the smallest table that holds the current entries; erases never shrink it
+    void shrinkToFit();
+    size_t size() const;
+    size_t getMemoryUsage() const;
+
+    // The entry's position of `to` inside the adjacency list of `from`
+    static uint32_t &positionIn(Positions &positions, int from, int to);
+
+private:
+    static constexpr uint64_t EMPTY = ~0ULL;
+
+    vector<uint64_t> keys;
+    vector<Positions> values;
+    size_t count;
+
+    static uint64_t makeKey(int u, int v);
+    size_t slotOf(uint64_t key) const;
+    void grow();
+    void rehash(size_t slots);
+};
+
+#endif // EDGE_INDEX_HPP
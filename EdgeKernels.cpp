@@ -0,0 +1,400 @@
+#include "EdgeKernels.hpp"
+#include "Graph.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define KERNELS_AVX2 1
+#define AVX2_TARGET __attribute__((target("avx2,popcnt")))
+#endif
+
+using namespace std;
+
+namespace {
+
+// -1 until the CPU has been asked
+atomic<int> activeIsa{-1};
+
+bool useAvx2() {
+    int isa = activeIsa.load(memory_order_relaxed);
+    if (isa < 0) {
+        isa = static_cast<int>(EdgeKernels::isSupported(KernelIsa::AVX2) ? KernelIsa::AVX2 : KernelIsa::SCALAR);
+        activeIsa.store(isa, memory_order_relaxed);
+    }
+    return isa == static_cast<int>(KernelIsa::AVX2);
+}
+
+template <typename Weight>
+Weight weightAt(const Weight *weights, size_t i, size_t strideBytes) {
+    return *reinterpret_cast<const Weight *>(reinterpret_cast<const char *>(weights) + i * strideBytes);
+}
+
+// Both versions finish a run with this, from position `first` on
+size_t keepUnconnectedScalar(const int *rootU, const int *rootV, size_t first, size_t count, uint32_t *kept,
+                             size_t n) {
+    for (size_t i = first; i < count; ++i) {
+        if (rootU[i] != rootV[i])
+            kept[n++] = static_cast<uint32_t>(i);
+    }
+    return n;
+}
+
+// The four-lane part of a floating-point summary, in the AVX2 lane order
+struct DoubleLanes
+{
+    double sums[4] = {0, 0, 0, 0};
+    double mins[4];
+};
+
+// Folds the lanes and then the positions from `first` on into summary; the AVX2 version
+// stops its lanes at the same position, so both add in the same order
+template <typename Weight>
+WeightSummary<Weight> finishSummary(const Weight *weights, size_t first, size_t count, size_t strideBytes,
+                                    const DoubleLanes *lanes, WeightSummary<Weight> summary) {
+    if (lanes && first > 0) {
+        summary.sum = (lanes->sums[0] + lanes->sums[1]) + (lanes->sums[2] + lanes->sums[3]);
+        summary.min = min(min(lanes->mins[0], lanes->mins[1]), min(lanes->mins[2], lanes->mins[3]));
+    }
+    for (size_t i = first; i < count; ++i) {
+        Weight w = weightAt(weights, i, strideBytes);
+        summary.sum += w;
+        summary.min = min(summary.min, w);
+    }
+    return summary;
+}
+
+template <typename Weight>
+WeightSummary<Weight> summarizeScalar(const Weight *weights, size_t count, size_t strideBytes) {
+    WeightSummary<Weight> summary;
+    if (count == 0)
+        return summary;
+    summary.min = weightAt(weights, 0, strideBytes);
+    if constexpr (is_floating_point_v<Weight>) {
+        DoubleLanes lanes;
+        fill(begin(lanes.mins), end(lanes.mins), numeric_limits<double>::max());
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            for (size_t lane = 0; lane < 4; ++lane) {
+                double w = weightAt(weights, i + lane, strideBytes);
+                lanes.sums[lane] += w;
+                lanes.mins[lane] = lanes.mins[lane] < w ? lanes.mins[lane] : w;
+            }
+        }
+        return finishSummary(weights, i, count, strideBytes, &lanes, summary);
+    }
+    else {
+        return finishSummary<Weight>(weights, 0, count, strideBytes, nullptr, summary);
+    }
+}
+
+template <typename Weight>
+size_t relaxCandidatesScalar(const int *targets, const Weight *weights, size_t first, size_t count,
+                             const Weight *key, uint32_t *improved, size_t n) {
+    for (size_t i = first; i < count; ++i) {
+        if (weights[i] < key[targets[i]])
+            improved[n++] = static_cast<uint32_t>(i);
+    }
+    return n;
+}
+
+#ifdef KERNELS_AVX2
+
+// For every 8-bit mask, the positions of its set bits packed into bytes, lowest first
+struct CompressTable
+{
+    uint64_t lanes[256];
+
+    CompressTable() {
+        for (int mask = 0; mask < 256; ++mask) {
+            uint64_t packed = 0;
+            int n = 0;
+            for (int lane = 0; lane < 8; ++lane) {
+                if (mask & (1 << lane))
+                    packed |= static_cast<uint64_t>(lane) << (8 * n++);
+            }
+            lanes[mask] = packed;
+        }
+    }
+};
+
+const CompressTable compressTable;
+
+// Appends base + lane for every set bit of mask
+size_t appendLanes(unsigned mask, size_t base, uint32_t *out, size_t n) {
+    while (mask) {
+        out[n++] = static_cast<uint32_t>(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return n;
+}
+
+AVX2_TARGET size_t keepUnconnectedAvx2(const int *rootU, const int *rootV, size_t count, uint32_t *kept) {
+    size_t n = 0, i = 0;
+    __m256i positions = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
+    for (; i + 8 <= count; i += 8) {
+        __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rootU + i));
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rootV + i));
+        unsigned same = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(u, v)));
+        unsigned keep = ~same & 0xFF;
+        // all eight lanes are stored; n <= i, so the spare ones still land inside kept
+        __m128i packed = _mm_cvtsi64_si128(static_cast<long long>(compressTable.lanes[keep]));
+        __m256i order = _mm256_cvtepu8_epi32(packed);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(kept + n), _mm256_permutevar8x32_epi32(positions, order));
+        n += _mm_popcnt_u32(keep);
+        positions = _mm256_add_epi32(positions, step);
+    }
+    return keepUnconnectedScalar(rootU, rootV, i, count, kept, n);
+}
+
+// Byte offsets of eight (or four) consecutive strided elements
+AVX2_TARGET __m256i laneOffsets8(size_t strideBytes) {
+    return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                              _mm256_set1_epi32(static_cast<int>(strideBytes)));
+}
+
+AVX2_TARGET __m128i laneOffsets4(size_t strideBytes) {
+    return _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(static_cast<int>(strideBytes)));
+}
+
+AVX2_TARGET long long sumLanes(__m256i sums) {
+    alignas(32) long long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sums);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+// 16-bit weights are gathered as 32-bit words and masked. The last element's word would reach
+// past its weight, so it is always left to the scalar tail.
+AVX2_TARGET WeightSummary<uint16_t> summarizeAvx2(const uint16_t *weights, size_t count, size_t strideBytes) {
+    WeightSummary<uint16_t> summary;
+    if (count == 0)
+        return summary;
+    const char *base = reinterpret_cast<const char *>(weights);
+    const __m256i offsets = laneOffsets8(strideBytes);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    __m256i sums = _mm256_setzero_si256();
+    __m256i minimum = low16;
+    size_t i = 0;
+    for (; i + 8 < count; i += 8) {
+        __m256i w = _mm256_and_si256(
+            _mm256_i32gather_epi32(reinterpret_cast<const int *>(base + i * strideBytes), offsets, 1), low16);
+        sums = _mm256_add_epi64(sums, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(w)));
+        sums = _mm256_add_epi64(sums, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(w, 1)));
+        minimum = _mm256_min_epu32(minimum, w);
+    }
+    alignas(32) uint32_t mins[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(mins), minimum);
+    summary.sum = sumLanes(sums);
+    summary.min = weightAt(weights, 0, strideBytes);
+    if (i > 0)
+        summary.min = static_cast<uint16_t>(*min_element(mins, mins + 8));
+    return finishSummary<uint16_t>(weights, i, count, strideBytes, nullptr, summary);
+}
+
+AVX2_TARGET WeightSummary<int> summarizeAvx2(const int *weights, size_t count, size_t strideBytes) {
+    WeightSummary<int> summary;
+    if (count == 0)
+        return summary;
+    const char *base = reinterpret_cast<const char *>(weights);
+    const __m256i offsets = laneOffsets8(strideBytes);
+    __m256i sums = _mm256_setzero_si256();
+    __m256i minimum = _mm256_set1_epi32(numeric_limits<int>::max());
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i w = _mm256_i32gather_epi32(reinterpret_cast<const int *>(base + i * strideBytes), offsets, 1);
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(w)));
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(w, 1)));
+        minimum = _mm256_min_epi32(minimum, w);
+    }
+    alignas(32) int mins[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(mins), minimum);
+    summary.sum = sumLanes(sums);
+    summary.min = weightAt(weights, 0, strideBytes);
+    if (i > 0)
+        summary.min = *min_element(mins, mins + 8);
+    return finishSummary<int>(weights, i, count, strideBytes, nullptr, summary);
+}
+
+AVX2_TARGET WeightSummary<int64_t> summarizeAvx2(const int64_t *weights, size_t count, size_t strideBytes) {
+    WeightSummary<int64_t> summary;
+    if (count == 0)
+        return summary;
+    const char *base = reinterpret_cast<const char *>(weights);
+    const __m128i offsets = laneOffsets4(strideBytes);
+    __m256i sums = _mm256_setzero_si256();
+    __m256i minimum = _mm256_set1_epi64x(numeric_limits<int64_t>::max());
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i w =
+            _mm256_i32gather_epi64(reinterpret_cast<const long long *>(base + i * strideBytes), offsets, 1);
+        sums = _mm256_add_epi64(sums, w);
+        minimum = _mm256_blendv_epi8(minimum, w, _mm256_cmpgt_epi64(minimum, w));
+    }
+    alignas(32) int64_t mins[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(mins), minimum);
+    summary.sum = sumLanes(sums);
+    summary.min = weightAt(weights, 0, strideBytes);
+    if (i > 0)
+        summary.min = *min_element(mins, mins + 4);
+    return finishSummary<int64_t>(weights, i, count, strideBytes, nullptr, summary);
+}
+
+AVX2_TARGET WeightSummary<double> summarizeAvx2(const double *weights, size_t count, size_t strideBytes) {
+    WeightSummary<double> summary;
+    if (count == 0)
+        return summary;
+    const char *base = reinterpret_cast<const char *>(weights);
+    const __m128i offsets = laneOffsets4(strideBytes);
+    __m256d sums = _mm256_setzero_pd();
+    __m256d minimum = _mm256_set1_pd(numeric_limits<double>::max());
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d w = _mm256_i32gather_pd(reinterpret_cast<const double *>(base + i * strideBytes), offsets, 1);
+        sums = _mm256_add_pd(sums, w);
+        // minimum < w ? minimum : w, lane by lane, like the scalar version
+        minimum = _mm256_min_pd(minimum, w);
+    }
+    DoubleLanes lanes;
+    _mm256_storeu_pd(lanes.sums, sums);
+    _mm256_storeu_pd(lanes.mins, minimum);
+    summary.min = weightAt(weights, 0, strideBytes);
+    return finishSummary(weights, i, count, strideBytes, &lanes, summary);
+}
+
+AVX2_TARGET size_t relaxCandidatesAvx2(const int *targets, const int *weights, size_t count, const int *key,
+                                       uint32_t *improved) {
+    size_t n = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(targets + i));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+        __m256i k = _mm256_i32gather_epi32(key, t, 4);
+        n = appendLanes(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, w))), i, improved, n);
+    }
+    return relaxCandidatesScalar(targets, weights, i, count, key, improved, n);
+}
+
+AVX2_TARGET size_t relaxCandidatesAvx2(const int *targets, const int64_t *weights, size_t count,
+                                       const int64_t *key, uint32_t *improved) {
+    size_t n = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(targets + i));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+        __m256i k = _mm256_i32gather_epi64(reinterpret_cast<const long long *>(key), t, 8);
+        n = appendLanes(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, w))), i, improved, n);
+    }
+    return relaxCandidatesScalar(targets, weights, i, count, key, improved, n);
+}
+
+AVX2_TARGET size_t relaxCandidatesAvx2(const int *targets, const double *weights, size_t count, const double *key,
+                                       uint32_t *improved) {
+    size_t n = 0, i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(targets + i));
+        __m256d w = _mm256_loadu_pd(weights + i);
+        __m256d k = _mm256_i32gather_pd(key, t, 8);
+        n = appendLanes(_mm256_movemask_pd(_mm256_cmp_pd(w, k, _CMP_LT_OQ)), i, improved, n);
+    }
+    return relaxCandidatesScalar(targets, weights, i, count, key, improved, n);
+}
+
+#endif // KERNELS_AVX2
+
+} // namespace
+
+KernelIsa EdgeKernels::getIsa() {
+    return useAvx2() ? KernelIsa::AVX2 : KernelIsa::SCALAR;
+}
+
+void EdgeKernels::setIsa(KernelIsa isa) {
+    if (!isSupported(isa))
+        isa = KernelIsa::SCALAR;
+    activeIsa.store(static_cast<int>(isa), memory_order_relaxed);
+}
+
+bool EdgeKernels::isSupported(KernelIsa isa) {
+    if (isa == KernelIsa::SCALAR)
+        return true;
+#ifdef KERNELS_AVX2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#else
+    return false;
+#endif
+}
+
+const char *EdgeKernels::isaName(KernelIsa isa) {
+    return isa == KernelIsa::AVX2 ? "avx2" : "scalar";
+}
+
+size_t EdgeKernels::keepUnconnected(const int *rootU, const int *rootV, size_t count, uint32_t *kept) {
+#ifdef KERNELS_AVX2
+    if (useAvx2())
+        return keepUnconnectedAvx2(rootU, rootV, count, kept);
+#endif
+    return keepUnconnectedScalar(rootU, rootV, 0, count, kept, 0);
+}
+
+template <typename Weight>
+WeightSummary<Weight> EdgeKernels::summarize(const Weight *weights, size_t count, size_t strideBytes) {
+#ifdef KERNELS_AVX2
+    if (useAvx2())
+        return summarizeAvx2(weights, count, strideBytes);
+#endif
+    return summarizeScalar(weights, count, strideBytes);
+}
+
+// There is no 16-bit gather, so 16-bit weights always take the scalar loop
+template <typename Weight>
+size_t EdgeKernels::relaxCandidates(const int *targets, const Weight *weights, size_t count, const Weight *key,
+                                    uint32_t *improved) {
+#ifdef KERNELS_AVX2
+    if constexpr (!is_same_v<Weight, uint16_t>) {
+        if (useAvx2())
+            return relaxCandidatesAvx2(targets, weights, count, key, improved);
+    }
+#endif
+    return relaxCandidatesScalar(targets, weights, 0, count, key, improved, 0);
+}
+
+// AVX2 has no scatter or conflict detection, so counting stays scalar; reading every byte of
+// a key in one pass still saves seven passes over the keys
+void EdgeKernels::byteHistograms(const uint64_t *keys, size_t count, size_t counts[8][256]) {
+    memset(counts, 0, sizeof(size_t) * 8 * 256);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = keys[i];
+        for (int b = 0; b < 8; ++b)
+            ++counts[b][(key >> (8 * b)) & 0xFF];
+    }
+}
+
+void EdgeKernels::radixSort(uint64_t *keys, uint64_t *scratch, size_t count) {
+    size_t counts[8][256];
+    byteHistograms(keys, count, counts);
+    uint64_t *from = keys, *to = scratch;
+    for (int b = 0; b < 8; ++b) {
+        size_t *digits = counts[b];
+        if (count == 0 || digits[(keys[0] >> (8 * b)) & 0xFF] == count)
+            continue;
+        size_t offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            size_t n = digits[d];
+            digits[d] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i)
+            to[digits[(from[i] >> (8 * b)) & 0xFF]++] = from[i];
+        swap(from, to);
+    }
+    if (from != keys)
+        memcpy(keys, from, count * sizeof(uint64_t));
+}
+
+#define INSTANTIATE_KERNELS(Index, Weight)                                                             \
+    template WeightSummary<Weight> EdgeKernels::summarize(const Weight *, size_t, size_t);            \
+    template size_t EdgeKernels::relaxCandidates(const int *, const Weight *, size_t, const Weight *, \
+                                                 uint32_t *);
+FOR_EACH_GRAPH_TYPE(INSTANTIATE_KERNELS)
+#undef INSTANTIATE_KERNELS
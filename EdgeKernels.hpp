@@ -0,0 +1,64 @@
+#ifndef EDGE_KERNELS_HPP
+#define EDGE_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+using namespace std;
+
+// Instruction sets the kernels are built for
+enum class KernelIsa
+{
+    SCALAR,
+    AVX2
+};
+
+// Sum and smallest of a run of weights; the sum is 64-bit for integral weights
+template <typename Weight>
+struct WeightSummary
+{
+    conditional_t<is_floating_point_v<Weight>, double, long long> sum = 0;
+    // Weight() for an empty run
+    Weight min = Weight();
+};
+
+//This class holds the inner loops of the MST strategies and measurements as batched kernels
+//over plain arrays. Every kernel has an AVX2 version and a scalar one that returns exactly the
+//same result (floating-point sums add in the same four-lane order); the AVX2 versions are
+//compiled for that target alone and chosen at run time, so the binary still runs on CPUs
+//without it. Weight kernels exist for every weight type in Graph.hpp; 16-bit weights have
+//no gather instruction and stay scalar where one would be needed.
+class EdgeKernels
+{
+public:
+    // The best instruction set the CPU supports, unless setIsa() pinned another
+    static KernelIsa getIsa();
+    // Pins the kernels to isa, falling back to SCALAR if the CPU lacks it; for benchmarks
+    static void setIsa(KernelIsa isa);
+    static bool isSupported(KernelIsa isa);
+    static const char *isaName(KernelIsa isa);
+
+    // Writes the positions i < count with rootU[i] != rootV[i], in order, to kept (room for
+    // count) and returns how many: a block of Kruskal's edges minus those already in one tree
+    static size_t keepUnconnected(const int *rootU, const int *rootV, size_t count, uint32_t *kept);
+
+    // Sum and minimum of count weights, strideBytes apart: sizeof(Weight) for a weight array,
+    // the edge size for the weights inside an edge list
+    template <typename Weight>
+    static WeightSummary<Weight> summarize(const Weight *weights, size_t count, size_t strideBytes);
+
+    // Writes the positions i < count with weights[i] < key[targets[i]] to improved (room for
+    // count) and returns how many: the neighbors whose lightest known edge a vertex improves
+    template <typename Weight>
+    static size_t relaxCandidates(const int *targets, const Weight *weights, size_t count, const Weight *key,
+                                  uint32_t *improved);
+
+    // counts[b][d]: keys whose byte b is d, for all eight bytes in one pass over the keys
+    static void byteHistograms(const uint64_t *keys, size_t count, size_t counts[8][256]);
+    // LSD radix sort by bytes; a byte that is the same in every key costs no pass. scratch
+    // needs room for count keys.
+    static void radixSort(uint64_t *keys, uint64_t *scratch, size_t count);
+};
+
+#endif // EDGE_KERNELS_HPP
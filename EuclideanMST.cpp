@@ -0,0 +1,213 @@
+#include "EuclideanMST.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const int LEAF_SIZE = 16;
+// points searched per pool item
+const size_t SEARCH_BLOCK = 1024;
+
+double distance2(const EuclideanMST::Point &a, const EuclideanMST::Point &b) {
+    double sum = 0;
+    for (int d = 0; d < 3; ++d)
+        sum += (a[d] - b[d]) * (a[d] - b[d]);
+    return sum;
+}
+
+// Squared distance from p to the nearest point of the box [low, high]
+double boxDistance2(const EuclideanMST::Point &p, const EuclideanMST::Point &low, const EuclideanMST::Point &high) {
+    double sum = 0;
+    for (int d = 0; d < 3; ++d) {
+        double gap = max(0.0, max(low[d] - p[d], p[d] - high[d]));
+        sum += gap * gap;
+    }
+    return sum;
+}
+
+int findRoot(vector<int> &parent, int v) {
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+// One candidate edge; ordered by length, then by the smaller and the larger endpoint
+struct Candidate
+{
+    double length2 = numeric_limits<double>::infinity();
+    int u = -1, v = -1;
+
+    bool operator<(const Candidate &other) const {
+        if (length2 != other.length2)
+            return length2 < other.length2;
+        if (min(u, v) != min(other.u, other.v))
+            return min(u, v) < min(other.u, other.v);
+        return max(u, v) < max(other.u, other.v);
+    }
+};
+
+} // namespace
+
+EuclideanMST::EuclideanMST(vector<Point> points) : points(move(points)) {
+    for (const Point &point : this->points) {
+        for (double coordinate : point) {
+            if (!(fabs(coordinate) <= MAX_COORDINATE))
+                throw runtime_error("Point coordinate out of range");
+        }
+    }
+    order.resize(this->points.size());
+    iota(order.begin(), order.end(), 0);
+    if (!order.empty())
+        build(0, static_cast<int>(order.size()));
+}
+
+int EuclideanMST::build(int begin, int end) {
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back({});
+    Point low = points[order[begin]], high = low;
+    for (int i = begin + 1; i < end; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            low[d] = min(low[d], points[order[i]][d]);
+            high[d] = max(high[d], points[order[i]][d]);
+        }
+    }
+    int left = -1, right = -1;
+    if (end - begin > LEAF_SIZE) {
+        // split the widest extent at the median
+        int axis = 0;
+        for (int d = 1; d < 3; ++d) {
+            if (high[d] - low[d] > high[axis] - low[axis])
+                axis = d;
+        }
+        int mid = begin + (end - begin) / 2;
+        nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                    [&](int a, int b) { return points[a][axis] < points[b][axis]; });
+        left = build(begin, mid);
+        right = build(mid, end);
+    }
+    nodes[index] = {low, high, begin, end, left, right, -1};
+    return index;
+}
+
+// Children come after their parent, so a reverse sweep sees them first
+void EuclideanMST::labelComponents(const vector<int> &componentOf) {
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node &node = nodes[i];
+        if (node.left < 0) {
+            node.component = componentOf[order[node.begin]];
+            for (int j = node.begin + 1; j < node.end && node.component >= 0; ++j) {
+                if (componentOf[order[j]] != node.component)
+                    node.component = -1;
+            }
+        }
+        else {
+            int left = nodes[node.left].component;
+            node.component = left == nodes[node.right].component ? left : -1;
+        }
+    }
+}
+
+pair<double, int> EuclideanMST::nearestForeign(int p, const vector<int> &componentOf) const {
+    const Point &point = points[p];
+    int own = componentOf[p];
+    double best = numeric_limits<double>::infinity();
+    int bestId = -1;
+
+    int stack[128];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        // a box exactly at the best distance may still hold a smaller id
+        if (node.component == own || boxDistance2(point, node.low, node.high) > best)
+            continue;
+        if (node.left < 0) {
+            for (int i = node.begin; i < node.end; ++i) {
+                int q = order[i];
+                if (componentOf[q] == own)
+                    continue;
+                double d = distance2(point, points[q]);
+                if (d < best || (d == best && q < bestId)) {
+                    best = d;
+                    bestId = q;
+                }
+            }
+            continue;
+        }
+        // the nearer child is searched first, so the farther one is usually pruned
+        double left = boxDistance2(point, nodes[node.left].low, nodes[node.left].high);
+        double right = boxDistance2(point, nodes[node.right].low, nodes[node.right].high);
+        if (left <= right) {
+            stack[top++] = node.right;
+            stack[top++] = node.left;
+        }
+        else {
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+    }
+    return {best, bestId};
+}
+
+EuclideanMST::EdgeList EuclideanMST::compute(ThreadPoll &pool, JobControl *control) {
+    int n = static_cast<int>(points.size());
+    EdgeList tree;
+    if (n < 2)
+        return tree;
+    tree.reserve(n - 1);
+
+    vector<int> parent(n);
+    iota(parent.begin(), parent.end(), 0);
+    vector<int> componentOf = parent;
+    vector<Candidate> nearest(n);
+    vector<Candidate> shortest(n);
+    size_t blocks = (n + SEARCH_BLOCK - 1) / SEARCH_BLOCK;
+
+    if (control)
+        control->startPhase("euclidean_mst");
+    while (static_cast<int>(tree.size()) < n - 1) {
+        labelComponents(componentOf);
+        if (control)
+            control->addWork(n);
+        pool.parallelFor(blocks, [&](size_t block) {
+            jobCheckpoint(control);
+            int last = min(n, static_cast<int>((block + 1) * SEARCH_BLOCK));
+            for (int p = static_cast<int>(block * SEARCH_BLOCK); p < last; ++p) {
+                pair<double, int> found = nearestForeign(p, componentOf);
+                nearest[p] = {found.first, p, found.second};
+            }
+            jobAdvance(control, last - block * SEARCH_BLOCK);
+        });
+
+        // every component keeps its shortest outgoing edge; the common order makes them acyclic
+        fill(shortest.begin(), shortest.end(), Candidate());
+        for (int p = 0; p < n; ++p) {
+            if (nearest[p] < shortest[componentOf[p]])
+                shortest[componentOf[p]] = nearest[p];
+        }
+        size_t before = tree.size();
+        for (int c = 0; c < n; ++c) {
+            const Candidate &edge = shortest[c];
+            if (edge.v < 0)
+                continue;
+            int a = findRoot(parent, edge.u), b = findRoot(parent, edge.v);
+            if (a == b)
+                continue;
+            parent[a] = b;
+            tree.push_back({sqrt(edge.length2), {edge.u, edge.v}});
+        }
+        // only an infinite distance leaves every component without an edge
+        if (tree.size() == before)
+            throw runtime_error("Euclidean MST made no progress");
+        for (int p = 0; p < n; ++p)
+            componentOf[p] = findRoot(parent, p);
+    }
+    return tree;
+}
@@ -0,0 +1,56 @@
+#ifndef EUCLIDEAN_MST_HPP
+#define EUCLIDEAN_MST_HPP
+
+#include "JobControl.hpp"
+#include "ThreadPoll.hpp"
+#include <array>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//This class computes the minimum spanning tree of a 2D or 3D point set under Euclidean
+//distance without building the complete graph. It runs Borůvka rounds over a k-d tree:
+//every round each point finds its nearest point in another component, searching the tree
+//split across the pool, and each component keeps its shortest such edge. Subtrees that lie
+//entirely inside the searching point's component are skipped, so later rounds stay cheap.
+class EuclideanMST
+{
+public:
+    // 2D points leave z at 0
+    using Point = array<double, 3>;
+    // (length, (u, v)), like BasicGraph::WeightedEdge
+    using EdgeList = vector<pair<double, pair<int, int>>>;
+    // Larger coordinates could overflow a squared distance to infinity
+    static constexpr double MAX_COORDINATE = 1e150;
+
+    // Throws if a coordinate is not finite or is beyond MAX_COORDINATE
+    explicit EuclideanMST(vector<Point> points);
+
+    // n - 1 edges for n points; ties are broken by the point ids, so the tree is deterministic
+    EdgeList compute(ThreadPoll &pool, JobControl *control = nullptr);
+
+private:
+    struct Node
+    {
+        Point low, high;
+        // points order[begin .. end)
+        int begin, end;
+        // children, -1 for a leaf
+        int left, right;
+        // the component every point below shares, or -1 when they differ
+        int component;
+    };
+
+    vector<Point> points;
+    // point ids in tree order; every node covers a contiguous range
+    vector<int> order;
+    vector<Node> nodes;
+
+    int build(int begin, int end);
+    void labelComponents(const vector<int> &componentOf);
+    // Nearest point of another component than p's: (squared distance, id), id -1 if none
+    pair<double, int> nearestForeign(int p, const vector<int> &componentOf) const;
+};
+
+#endif // EUCLIDEAN_MST_HPP
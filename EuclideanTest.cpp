@@ -0,0 +1,99 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "EuclideanMST.hpp"
+#include "Graph.hpp"
+#include "StrategyFactory.hpp"
+#include "ThreadPoll.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool condition, const string &what) {
+    if (!condition) {
+        cerr << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+double totalLength(const EuclideanMST::EdgeList &tree) {
+    double total = 0;
+    for (const auto &edge : tree)
+        total += edge.first;
+    return total;
+}
+
+// The Euclidean MST has the weight of Kruskal's tree over the complete distance graph
+void compareWithKruskal(ThreadPoll &pool, int n, int dimension, uint64_t seed) {
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> coordinate(-1000, 1000);
+    vector<EuclideanMST::Point> points(n, EuclideanMST::Point{0, 0, 0});
+    for (auto &point : points) {
+        for (int d = 0; d < dimension; ++d)
+            point[d] = coordinate(rng);
+    }
+
+    BasicGraph<int, double> complete(n);
+    for (int u = 0; u < n; ++u) {
+        for (int v = u + 1; v < n; ++v) {
+            double sum = 0;
+            for (int d = 0; d < 3; ++d)
+                sum += (points[u][d] - points[v][d]) * (points[u][d] - points[v][d]);
+            complete.addEdge(u, v, sqrt(sum));
+        }
+    }
+    auto expected = BasicKruskalMST<int, double>().computeMST(complete);
+    auto tree = EuclideanMST(points).compute(pool);
+
+    string label = to_string(n) + " points in " + to_string(dimension) + "D";
+    check(tree.size() == static_cast<size_t>(n - 1), label + ": n - 1 edges");
+    double want = 0;
+    for (const auto &edge : expected)
+        want += edge.first;
+    check(fabs(totalLength(tree) - want) <= 1e-9 * max(1.0, want), label + ": same weight as Kruskal");
+}
+
+int main() {
+    ThreadPoll pool(2);
+
+    compareWithKruskal(pool, 2, 2, 1);
+    compareWithKruskal(pool, 300, 2, 2);
+    compareWithKruskal(pool, 300, 3, 3);
+    // many equal distances
+    {
+        vector<EuclideanMST::Point> grid;
+        for (int x = 0; x < 20; ++x) {
+            for (int y = 0; y < 20; ++y)
+                grid.push_back({double(x), double(y), 0});
+        }
+        auto tree = EuclideanMST(grid).compute(pool);
+        check(tree.size() == grid.size() - 1 && totalLength(tree) == grid.size() - 1.0, "unit grid: all edges of length 1");
+    }
+
+    // squared distances of these would overflow to infinity, so they are refused up front
+    bool refused = false;
+    try {
+        EuclideanMST({{0, 0, 0}, {1e200, 0, 0}});
+    }
+    catch (const runtime_error &) {
+        refused = true;
+    }
+    check(refused, "coordinates beyond MAX_COORDINATE are refused");
+    // the largest accepted coordinates still give finite distances
+    {
+        double m = EuclideanMST::MAX_COORDINATE;
+        auto tree = EuclideanMST({{-m, -m, -m}, {m, m, m}, {0, 0, 0}}).compute(pool);
+        check(tree.size() == 2 && isfinite(totalLength(tree)), "extreme coordinates: finite tree");
+    }
+
+    if (failures) {
+        cerr << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "All Euclidean MST tests passed" << endl;
+    return 0;
+}
@@ -1,53 +1,133 @@
 #include "Graph.hpp"
+#include "ThreadPoll.hpp"
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <limits>
 #include <queue>
+#include <sstream>
 #include <stdexcept>
 
 using namespace std;
 
-Graph::Graph(int vertices) : V(vertices), adjList(vertices), parent(vertices, -1) {}
+namespace {
 
-void Graph::addEdge(int u, int v, int weight){
-    adjList[u].push_back({v, weight});
-    adjList[v].push_back({u, weight});
-}
+// Work is handed out in blocks of vertices (bottom-up) or frontier entries (top-down)
+const size_t BFS_BLOCK = 2048;
+// Beamer et al.: go bottom-up once the frontier's edges exceed 1/ALPHA of the unexplored ones,
+// and back top-down once the frontier holds fewer than 1/BETA of the vertices
+const long long BFS_ALPHA = 14;
+const long long BFS_BETA = 24;
 
-vector<pair<int, pair<int, int>>> Graph::getEdges() const{
-    vector<pair<int, pair<int, int>>> edges;
-    for (int u = 0; u < V; ++u)
-    {
-        for (const auto &edge : adjList[u])
-        {
-            int v = edge.first;
-            int weight = edge.second;
-            if (u < v)
-                edges.push_back({weight, {u, v}});
-        }
+void forEachBlock(ThreadPoll *pool, size_t blocks, const function<void(size_t)> &body) {
+    if (pool && blocks > 1) {
+        pool->parallelFor(blocks, body);
+        return;
     }
-    return edges;
+    for (size_t block = 0; block < blocks; ++block)
+        body(block);
 }
 
-void Graph::buildSpanningTree(int root){
-    vector<bool> visited(V, false);
-    dfs(root, visited);
-}
+template <typename Index, typename Weight>
+SpanningTree directionOptimizingBFS(const BasicGraph<Index, Weight> &graph, int root, ThreadPoll *pool) {
+    int V = graph.getNumVertices();
+    if (root < 0 || root >= V) {
+        throw runtime_error("Vertex index out of bounds");
+    }
 
-void Graph::dfs(int v, vector<bool> &visited){
-    visited[v] = true;
-    for (const auto &edge : adjList[v])
-    {
-        int u = edge.first;
-        if (!visited[u])
-        {
-            parent[u] = v;
-            dfs(u, visited);
+    // parent[v] == -1 while v is unvisited; the root points to itself until the end
+    unique_ptr<atomic<int>[]> parent(new atomic<int>[V]);
+    for (int v = 0; v < V; ++v)
+        parent[v].store(-1, memory_order_relaxed);
+    parent[root].store(root, memory_order_relaxed);
+
+    vector<int> frontier{root};
+    vector<char> inFrontier(V, 0), inNext(V, 0);
+    size_t vertexBlocks = (V + BFS_BLOCK - 1) / BFS_BLOCK;
+
+    long long unexploredEdges = 0;
+    for (int v = 0; v < V; ++v)
+        unexploredEdges += graph.getAdjacentEdges(v).size();
+    bool bottomUp = false;
+
+    while (!frontier.empty()) {
+        long long frontierEdges = 0;
+        for (int u : frontier)
+            frontierEdges += graph.getAdjacentEdges(u).size();
+        unexploredEdges -= frontierEdges;
+        if (!bottomUp && frontierEdges * BFS_ALPHA > unexploredEdges)
+            bottomUp = true;
+        else if (bottomUp && static_cast<long long>(frontier.size()) * BFS_BETA < V)
+            bottomUp = false;
+
+        vector<int> next;
+        if (bottomUp) {
+            for (int u : frontier)
+                inFrontier[u] = 1;
+            // each block only writes its own vertices, so no atomics are contended here
+            forEachBlock(pool, vertexBlocks, [&](size_t block) {
+                int end = min<int>(V, (block + 1) * BFS_BLOCK);
+                for (int v = block * BFS_BLOCK; v < end; ++v) {
+                    if (parent[v].load(memory_order_relaxed) != -1)
+                        continue;
+                    for (const auto &edge : graph.getAdjacentEdges(v)) {
+                        int u = static_cast<int>(edge.first);
+                        if (inFrontier[u]) {
+                            parent[v].store(u, memory_order_relaxed);
+                            inNext[v] = 1;
+                            break;
+                        }
+                    }
+                }
+            });
+            for (int u : frontier)
+                inFrontier[u] = 0;
+            for (int v = 0; v < V; ++v) {
+                if (inNext[v]) {
+                    inNext[v] = 0;
+                    next.push_back(v);
+                }
+            }
+        }
+        else {
+            size_t frontierBlocks = (frontier.size() + BFS_BLOCK - 1) / BFS_BLOCK;
+            vector<vector<int>> discovered(frontierBlocks);
+            forEachBlock(pool, frontierBlocks, [&](size_t block) {
+                size_t end = min(frontier.size(), (block + 1) * BFS_BLOCK);
+                for (size_t i = block * BFS_BLOCK; i < end; ++i) {
+                    int u = frontier[i];
+                    for (const auto &edge : graph.getAdjacentEdges(u)) {
+                        int v = static_cast<int>(edge.first);
+                        int unvisited = -1;
+                        // the first frontier vertex to claim v becomes its parent
+                        if (parent[v].load(memory_order_relaxed) == -1 &&
+                            parent[v].compare_exchange_strong(unvisited, u, memory_order_relaxed))
+                            discovered[block].push_back(v);
+                    }
+                }
+            });
+            for (const auto &part : discovered)
+                next.insert(next.end(), part.begin(), part.end());
         }
+        frontier.swap(next);
     }
+
+    vector<int> result(V);
+    for (int v = 0; v < V; ++v)
+        result[v] = parent[v].load(memory_order_relaxed);
+    result[root] = -1;
+    return SpanningTree(root, move(result));
 }
 
-vector<int> Graph::getPath(int v) const{
+} // namespace
+
+SpanningTree::SpanningTree(int root, vector<int> parent) : root(root), parent(move(parent)) {}
+
+vector<int> SpanningTree::getPath(int v) const{
     vector<int> path;
+    if (!reaches(v))
+        return path;
     while (v != -1)
     {
         path.push_back(v);
@@ -57,62 +137,326 @@ vector<int> Graph::getPath(int v) const{
     return path;
 }
 
-int Graph::getNumVertices() const{
+int SpanningTree::getRoot() const{
+    return root;
+}
+
+int SpanningTree::getParent(int v) const{
+    return parent[v];
+}
+
+bool SpanningTree::reaches(int v) const{
+    return v >= 0 && v < static_cast<int>(parent.size()) && (v == root || parent[v] != -1);
+}
+
+template <typename Index, typename Weight>
+BasicGraph<Index, Weight>::BasicGraph(int vertices) : V(vertices), adjList(vertices), removed(vertices) {}
+
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::setDuplicatePolicy(DuplicatePolicy policy){
+    if (policy == duplicatePolicy)
+        return;
+    duplicatePolicy = policy;
+    if (policy == DuplicatePolicy::ALLOW) {
+        edgeIndex.clear();
+        return;
+    }
+    rebuildEdgeIndex();
+}
+
+template <typename Index, typename Weight>
+DuplicatePolicy BasicGraph<Index, Weight>::getDuplicatePolicy() const{
+    return duplicatePolicy;
+}
+
+// Re-adds every edge through the index, merging parallel edges by the policy; REJECT keeps
+// the first of each pair, and self-loops are dropped
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::rebuildEdgeIndex(){
+    vector<WeightedEdge> edges = getEdges();
+    for (auto &neighbors : adjList)
+        neighbors.clear();
+    edgeIndex.clear();
+
+    for (const auto &edge : edges) {
+        Index u = edge.second.first, v = edge.second.second;
+        if (duplicatePolicy == DuplicatePolicy::REJECT && edgeIndex.find(u, v))
+            continue;
+        addEdge(u, v, edge.first);
+    }
+}
+
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::addEdge(Index u, Index v, Weight weight){
+    if (duplicatePolicy == DuplicatePolicy::ALLOW) {
+        appendNeighbor(u, {v, weight});
+        appendNeighbor(v, {u, weight});
+        return;
+    }
+    if (u == v)
+        throw runtime_error("Self-loops are not allowed with a duplicate edge policy");
+
+    if (EdgeIndex::Positions *positions = edgeIndex.find(u, v)) {
+        Weight &fromU = adjList[u][EdgeIndex::positionIn(*positions, u, v)].second;
+        Weight &fromV = adjList[v][EdgeIndex::positionIn(*positions, v, u)].second;
+        if (duplicatePolicy == DuplicatePolicy::REJECT)
+            throw runtime_error("Edge already exists: " + to_string(+u) + " " + to_string(+v));
+        if (duplicatePolicy == DuplicatePolicy::REPLACE || weight < fromU) {
+            fromU = weight;
+            fromV = weight;
+        }
+        return;
+    }
+
+    EdgeIndex::Positions positions;
+    EdgeIndex::positionIn(positions, u, v) = static_cast<uint32_t>(adjList[u].size());
+    EdgeIndex::positionIn(positions, v, u) = static_cast<uint32_t>(adjList[v].size());
+    appendNeighbor(u, {v, weight});
+    appendNeighbor(v, {u, weight});
+    edgeIndex.insert(u, v, positions);
+}
+
+// Pushes onto adjList[from], adding any growth of its capacity to neighborCapacity
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::appendNeighbor(int from, Neighbor neighbor){
+    auto &neighbors = adjList[from];
+    size_t before = neighbors.capacity();
+    neighbors.push_back(neighbor);
+    neighborCapacity += neighbors.capacity() - before;
+}
+
+// Swap-removes adjList[from][position] and repoints the index entry of the edge moved into it
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::detachNeighbor(int from, uint32_t position){
+    auto &neighbors = adjList[from];
+    uint32_t last = static_cast<uint32_t>(neighbors.size() - 1);
+    if (position != last) {
+        neighbors[position] = neighbors[last];
+        int moved = static_cast<int>(neighbors[position].first);
+        EdgeIndex::positionIn(*edgeIndex.find(from, moved), from, moved) = position;
+    }
+    neighbors.pop_back();
+}
+
+template <typename Index, typename Weight>
+vector<typename BasicGraph<Index, Weight>::WeightedEdge> BasicGraph<Index, Weight>::getEdges() const{
+    vector<WeightedEdge> edges;
+    for (int u = 0; u < V; ++u)
+    {
+        for (const auto &edge : adjList[u])
+        {
+            Index v = edge.first;
+            Weight weight = edge.second;
+            if (static_cast<Index>(u) < v)
+                edges.push_back({weight, {static_cast<Index>(u), v}});
+        }
+    }
+    return edges;
+}
+
+template <typename Index, typename Weight>
+SpanningTree BasicGraph<Index, Weight>::buildSpanningTree(int root) const{
+    return directionOptimizingBFS(*this, root, nullptr);
+}
+
+template <typename Index, typename Weight>
+SpanningTree BasicGraph<Index, Weight>::buildSpanningTree(int root, ThreadPoll &pool) const{
+    return directionOptimizingBFS(*this, root, &pool);
+}
+
+template <typename Index, typename Weight>
+int BasicGraph<Index, Weight>::getNumVertices() const{
     return V;
 }
 
-vector<pair<int, int>> Graph::getAdjacentEdges(int v) const{
+template <typename Index, typename Weight>
+int BasicGraph<Index, Weight>::getNumRemovedVertices() const{
+    return removedCount;
+}
+
+template <typename Index, typename Weight>
+bool BasicGraph<Index, Weight>::hasVertex(int v) const{
+    return v >= 0 && v < V && !removed[v];
+}
+
+template <typename Index, typename Weight>
+const vector<typename BasicGraph<Index, Weight>::Neighbor> &BasicGraph<Index, Weight>::getAdjacentEdges(int v) const{
     return adjList[v];
 }
 
-void Graph::removeEdge(int u, int v) {
+template <typename Index, typename Weight>
+size_t BasicGraph<Index, Weight>::getMemoryUsage() const{
+    return adjList.capacity() * sizeof(vector<Neighbor>) + neighborCapacity * sizeof(Neighbor) +
+           edgeIndex.getMemoryUsage() + removed.capacity() + freeSlots.capacity() * sizeof(int);
+}
+
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::removeEdge(Index u, Index v) {
+    if (duplicatePolicy != DuplicatePolicy::ALLOW) {
+        EdgeIndex::Positions *positions = edgeIndex.find(u, v);
+        if (!positions)
+            return;
+        uint32_t inU = EdgeIndex::positionIn(*positions, u, v);
+        uint32_t inV = EdgeIndex::positionIn(*positions, v, u);
+        edgeIndex.erase(u, v);
+        detachNeighbor(u, inU);
+        detachNeighbor(v, inV);
+        return;
+    }
+
     // Remove edge from u's adjacency list
     auto &uEdges = adjList[u];
     uEdges.erase(remove_if(uEdges.begin(), uEdges.end(),
-                           [v](const pair<int, int> &edge) { return edge.first == v; }),
+                           [v](const Neighbor &edge) { return edge.first == v; }),
                  uEdges.end());
 
     // Remove edge from v's adjacency list
     auto &vEdges = adjList[v];
     vEdges.erase(remove_if(vEdges.begin(), vEdges.end(),
-                           [u](const pair<int, int> &edge) { return edge.first == u; }),
+                           [u](const Neighbor &edge) { return edge.first == u; }),
                  vEdges.end());
 }
 
-void Graph::addVertex(int newVertex) {
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::addVertex(int newVertex) {
     if (newVertex >= V) {
-        // Increase the size of the adjacency list and parent vector
+        // Increase the size of the adjacency list
         adjList.resize(newVertex + 1);
-        parent.resize(newVertex + 1, -1);
+        removed.resize(newVertex + 1);
         V = newVertex + 1; // Update the number of vertices
     }
+    else if (newVertex >= 0 && removed[newVertex]) {
+        // its free-list entry goes stale and is skipped by addVertex()
+        removed[newVertex] = 0;
+        --removedCount;
+    }
 }
 
-void Graph::removeVertex(int vertexToRemove) {
-    if (vertexToRemove >= V || vertexToRemove < 0) {
+template <typename Index, typename Weight>
+int BasicGraph<Index, Weight>::addVertex() {
+    while (!freeSlots.empty()) {
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        if (slot < V && removed[slot]) {
+            removed[slot] = 0;
+            --removedCount;
+            return slot;
+        }
+    }
+    addVertex(V);
+    return V - 1;
+}
+
+template <typename Index, typename Weight>
+void BasicGraph<Index, Weight>::removeVertex(int vertexToRemove) {
+    if (!hasVertex(vertexToRemove)) {
         throw runtime_error("Vertex index out of bounds");
     }
 
-    // Remove all edges connected to the vertex
-    for (int i = 0; i < V; ++i) {
-        if (i == vertexToRemove) continue;
-        auto &edges = adjList[i];
-        edges.erase(std::remove_if(edges.begin(), edges.end(),
-                                   [vertexToRemove](const std::pair<int, int> &edge) { return edge.first == vertexToRemove; }),
-                    edges.end());
+    auto &edges = adjList[vertexToRemove];
+    if (duplicatePolicy != DuplicatePolicy::ALLOW) {
+        // the back entry moves nothing on this side, so each removal is O(1)
+        while (!edges.empty())
+            removeEdge(static_cast<Index>(vertexToRemove), edges.back().first);
+    }
+    else {
+        for (const auto &edge : edges) {
+            int neighbor = static_cast<int>(edge.first);
+            if (neighbor == vertexToRemove)
+                continue;
+            auto &back = adjList[neighbor];
+            back.erase(remove_if(back.begin(), back.end(),
+                                 [vertexToRemove](const Neighbor &e) { return static_cast<int>(e.first) == vertexToRemove; }),
+                       back.end());
+        }
+    }
+    neighborCapacity -= edges.capacity();
+    vector<Neighbor>().swap(edges);
+
+    removed[vertexToRemove] = 1;
+    ++removedCount;
+    freeSlots.push_back(vertexToRemove);
+}
+
+template <typename Index, typename Weight>
+vector<int> BasicGraph<Index, Weight>::compact() {
+    vector<int> newId(V, -1);
+    int live = 0;
+    for (int v = 0; v < V; ++v) {
+        if (!removed[v])
+            newId[v] = live++;
     }
 
-    // Remove the vertex itself
-    adjList.erase(adjList.begin() + vertexToRemove);
-    parent.erase(parent.begin() + vertexToRemove);
-    V--; // Update the number of vertices
+    for (int v = 0; v < V; ++v) {
+        if (newId[v] < 0)
+            continue;
+        for (auto &edge : adjList[v])
+            edge.first = static_cast<Index>(newId[edge.first]);
+        if (newId[v] != v)
+            adjList[newId[v]] = move(adjList[v]);
+    }
+    adjList.resize(live);
+    adjList.shrink_to_fit();
+    V = live;
+    removed.assign(V, 0);
+    vector<int>().swap(freeSlots);
+    removedCount = 0;
 
-    // Update adjacency lists to reflect the new vertex indices
-    for (auto &edges : adjList) {
-        for (auto &edge : edges) {
-            if (edge.first > vertexToRemove) {
-                edge.first--;
-            }
+    if (duplicatePolicy != DuplicatePolicy::ALLOW)
+        rebuildEdgeIndex();
+    neighborCapacity = 0;
+    for (const auto &neighbors : adjList)
+        neighborCapacity += neighbors.capacity();
+    return newId;
+}
+
+template <typename Index, typename Weight>
+size_t BasicGraph<Index, Weight>::shrinkToFit() {
+    size_t before = getMemoryUsage();
+    neighborCapacity = 0;
+    for (auto &neighbors : adjList) {
+        neighbors.shrink_to_fit();
+        neighborCapacity += neighbors.capacity();
+    }
+    adjList.shrink_to_fit();
+    removed.shrink_to_fit();
+    // entries of ids revived by addVertex(id) are stale
+    freeSlots.erase(remove_if(freeSlots.begin(), freeSlots.end(), [this](int slot) { return !removed[slot]; }),
+                    freeSlots.end());
+    freeSlots.shrink_to_fit();
+    edgeIndex.shrinkToFit();
+    size_t after = getMemoryUsage();
+    return before > after ? before - after : 0;
+}
+
+#define INSTANTIATE_GRAPH(Index, Weight) template class BasicGraph<Index, Weight>;
+FOR_EACH_GRAPH_TYPE(INSTANTIATE_GRAPH)
+#undef INSTANTIATE_GRAPH
+
+WeightValue parseWeight(const string &token) {
+    size_t used = 0;
+    try {
+        if (token.find_first_of(".eE") == string::npos) {
+            long long value = stoll(token, &used);
+            if (used == token.size())
+                return value;
         }
+        else {
+            double value = stod(token, &used);
+            if (used == token.size())
+                return value;
+        }
+    }
+    catch (const logic_error &) {
+        // reported below like any other malformed token
     }
-}
\ No newline at end of file
+    throw runtime_error("Invalid weight: " + token);
+}
+
+string weightToString(const WeightValue &weight) {
+    if (holds_alternative<long long>(weight))
+        return to_string(get<long long>(weight));
+    ostringstream oss;
+    oss << get<double>(weight);
+    return oss.str();
+}
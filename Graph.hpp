@@ -1,35 +1,141 @@
 #pragma once
+#include "EdgeIndex.hpp"
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <variant>
 #include <vector>
 #include <utility>
 
 using namespace std;
 
-struct Edge
+template <typename Index, typename Weight>
+struct BasicEdge
 {
-    int src, dest, weight;
+    Index src, dest;
+    Weight weight;
 };
 
-class Graph
+class ThreadPoll;
+
+//This class is a BFS spanning tree of a graph, kept apart from the graph so any number of
+//readers can build and query trees concurrently. parent is -1 for the root and for vertices
+//the root cannot reach.
+class SpanningTree
 {
+public:
+    SpanningTree(int root, vector<int> parent);
+
+    // root ... v, or empty when v is not reachable from the root
+    vector<int> getPath(int v) const;
+    int getRoot() const;
+    int getParent(int v) const;
+    bool reaches(int v) const;
+
 private:
-    int V;
-    vector<vector<pair<int, int>>> adjList;
+    int root;
     vector<int> parent;
-    void dfs(int v, vector<bool> &visited);
+};
 
+// Index is the vertex-id type, Weight the edge-weight type.
+// Graph (int, int) is what the server protocol uses; the narrower and wider
+// instantiations below let the algorithms trade memory bandwidth for range.
+template <typename Index, typename Weight>
+class BasicGraph
+{
 public:
-    Graph(int vertices);
-    
-    // graph operations
-    void addEdge(int u, int v, int weight);
-    void removeEdge(int u, int v);
+    using IndexType = Index;
+    using WeightType = Weight;
+    using Neighbor = pair<Index, Weight>;
+    using WeightedEdge = pair<Weight, pair<Index, Index>>;
+
+private:
+    int V;
+    vector<vector<Neighbor>> adjList;
+    // Every policy but ALLOW keeps at most one edge per vertex pair and indexes it
+    DuplicatePolicy duplicatePolicy = DuplicatePolicy::ALLOW;
+    EdgeIndex edgeIndex;
+    // Removed vertices keep their slot (and id) until compact(); freeSlots lists them for reuse
+    vector<char> removed;
+    vector<int> freeSlots;
+    int removedCount = 0;
+    // Neighbor slots reserved across all adjacency lists, so getMemoryUsage() is O(1).
+    // A copy carries the source's count until its next shrinkToFit().
+    size_t neighborCapacity = 0;
+
+    void appendNeighbor(int from, Neighbor neighbor);
+    void detachNeighbor(int from, uint32_t position);
+    void rebuildEdgeIndex();
+
+public:
+    BasicGraph(int vertices);
+
+    // Switching away from ALLOW merges existing parallel edges by the new policy
+    // (REJECT keeps the first). Indexed graphs refuse self-loops.
+    void setDuplicatePolicy(DuplicatePolicy policy);
+    DuplicatePolicy getDuplicatePolicy() const;
+
+    // graph operations; with an edge index, addEdge applies the duplicate policy
+    // (REJECT throws) and removeEdge is O(1) instead of a scan of both lists
+    void addEdge(Index u, Index v, Weight weight);
+    void removeEdge(Index u, Index v);
+    // Vertex ids are stable: removeVertex only drops the vertex's edges, in O(degree) with an
+    // edge index, and leaves a tombstone. addVertex(id) grows the graph or revives that id;
+    // addVertex() reuses a removed id, or appends one.
     void addVertex(int newVertex);
+    int addVertex();
     void removeVertex(int vertexToRemove);
-    
+    // Renumbers the live vertices densely in their current order and drops the tombstones.
+    // Returns the new id of every old id, -1 for removed ones.
+    vector<int> compact();
+    // Releases the capacity that growth and removals left unused, in the adjacency lists and
+    // the edge index; ids and edges stay as they are. Returns the bytes released.
+    size_t shrinkToFit();
+
     // information about the graph
-    vector<pair<int, pair<int, int>>> getEdges() const;
-    void buildSpanningTree(int root);
-    vector<int> getPath(int v) const;
+    vector<WeightedEdge> getEdges() const;
+    // Iterative direction-optimizing BFS from root: top-down steps while the frontier is
+    // small, bottom-up steps (unvisited vertices look for a parent in the frontier) while it
+    // covers a large share of the edges. With a pool, every step is split across its threads.
+    SpanningTree buildSpanningTree(int root) const;
+    SpanningTree buildSpanningTree(int root, ThreadPoll &pool) const;
+    // Size of the id space, removed vertices included
     int getNumVertices() const;
-    vector<pair<int, int>> getAdjacentEdges(int v) const;
+    int getNumRemovedVertices() const;
+    bool hasVertex(int v) const;
+    const vector<Neighbor> &getAdjacentEdges(int v) const;
+    // Heap bytes held: adjacency lists, edge index and vertex bookkeeping
+    size_t getMemoryUsage() const;
 };
+
+using Edge = BasicEdge<int, int>;
+using Graph = BasicGraph<int, int>;
+
+// Every (Index, Weight) pair a graph can be stored as, narrowest first.
+// Graph.cpp, StrategyFactory.cpp and ClientGraph.cpp instantiate their templates for each.
+#define FOR_EACH_GRAPH_TYPE(X) \
+    X(uint16_t, uint16_t)      \
+    X(int, int)                \
+    X(int, int64_t)            \
+    X(int, double)
+
+#define DECLARE_GRAPH(Index, Weight) extern template class BasicGraph<Index, Weight>;
+FOR_EACH_GRAPH_TYPE(DECLARE_GRAPH)
+#undef DECLARE_GRAPH
+
+// A weight, or a sum of weights, independent of the graph's weight type.
+// Integral values are kept exact in 64 bits, floating-point ones as double.
+using WeightValue = variant<long long, double>;
+
+template <typename Weight>
+WeightValue widenWeight(Weight weight)
+{
+    if constexpr (is_floating_point_v<Weight>)
+        return static_cast<double>(weight);
+    else
+        return static_cast<long long>(weight);
+}
+
+// Reads "12" as an integral weight and "1.5" / "1e3" as a floating-point one; throws on garbage
+WeightValue parseWeight(const string &token);
+string weightToString(const WeightValue &weight);
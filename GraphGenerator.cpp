@@ -0,0 +1,167 @@
+#include "GraphGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+GraphGenerator::GraphGenerator(const GeneratorConfig &config) : config(config), rng(config.seed) {
+    if (config.vertices <= 0 || config.maxWeight <= 0) {
+        throw runtime_error("Generator needs a positive vertex count and weight range");
+    }
+}
+
+Graph GraphGenerator::generate() {
+    existing.clear();
+    if (config.type == "random")
+        return generateRandom();
+    if (config.type == "grid")
+        return generateGrid();
+    if (config.type == "rmat")
+        return generateRMAT();
+    if (config.type == "complete")
+        return generateComplete();
+    throw runtime_error("Unknown graph type: " + config.type);
+}
+
+int GraphGenerator::nextWeight() {
+    double w;
+    if (config.weights == "uniform") {
+        w = uniform_int_distribution<int>(1, config.maxWeight)(rng);
+    }
+    else if (config.weights == "normal") {
+        w = normal_distribution<double>(config.maxWeight / 2.0, config.maxWeight / 6.0)(rng);
+    }
+    else if (config.weights == "exponential") {
+        w = exponential_distribution<double>(8.0 / config.maxWeight)(rng);
+    }
+    else {
+        throw runtime_error("Unknown weight distribution: " + config.weights);
+    }
+    return static_cast<int>(clamp(lround(w), 1L, static_cast<long>(config.maxWeight)));
+}
+
+// Adds u-v unless it is a self loop or the pair is already connected; returns whether it was added
+bool GraphGenerator::addUniqueEdge(Graph &graph, int u, int v) {
+    if (u == v)
+        return false;
+    uint64_t key = (static_cast<uint64_t>(min(u, v)) << 32) | static_cast<uint32_t>(max(u, v));
+    if (!existing.insert(key).second)
+        return false;
+    graph.addEdge(u, v, nextWeight());
+    return true;
+}
+
+// Links every component to a random vertex of the component holding vertex 0, so the MST
+// covers the whole graph. Adds at most (components - 1) edges.
+void GraphGenerator::connectComponents(Graph &graph) {
+    int V = graph.getNumVertices();
+    vector<int> root(V);
+    iota(root.begin(), root.end(), 0);
+    auto find = [&root](int x) {
+        while (root[x] != x)
+            x = root[x] = root[root[x]];
+        return x;
+    };
+    for (const auto &edge : graph.getEdges())
+        root[find(edge.second.first)] = find(edge.second.second);
+
+    vector<int> connected;
+    for (int v = 0; v < V; ++v)
+        if (find(v) == find(0))
+            connected.push_back(v);
+
+    for (int v = 1; v < V; ++v) {
+        if (find(v) == find(0))
+            continue;
+        int target = connected[uniform_int_distribution<size_t>(0, connected.size() - 1)(rng)];
+        root[find(v)] = find(0);
+        addUniqueEdge(graph, v, target);
+        connected.push_back(v);
+    }
+}
+
+// Number of distinct edges to draw: n * degree / 2, capped at the complete graph
+static long long targetEdges(int V, double averageDegree) {
+    long long m = static_cast<long long>(V * averageDegree / 2);
+    return min(m, static_cast<long long>(V) * (V - 1) / 2);
+}
+
+// G(n, m): m distinct edges between uniformly chosen endpoints, then joined into one component
+Graph GraphGenerator::generateRandom() {
+    int V = config.vertices;
+    Graph graph(V);
+    long long m = targetEdges(V, config.averageDegree);
+    uniform_int_distribution<int> pick(0, V - 1);
+    for (long long added = 0; added < m;) {
+        if (addUniqueEdge(graph, pick(rng), pick(rng)))
+            ++added;
+    }
+    connectComponents(graph);
+    return graph;
+}
+
+// Square-ish 4-neighbour grid holding exactly config.vertices vertices
+Graph GraphGenerator::generateGrid() {
+    int V = config.vertices;
+    int cols = max(1, static_cast<int>(sqrt(static_cast<double>(V))));
+    Graph graph(V);
+    for (int u = 0; u < V; ++u) {
+        if ((u + 1) % cols != 0 && u + 1 < V)
+            addUniqueEdge(graph, u, u + 1);
+        if (u + cols < V)
+            addUniqueEdge(graph, u, u + cols);
+    }
+    return graph;
+}
+
+// Recursive matrix generator (Chakrabarti et al.) with the Graph500 quadrant probabilities.
+// Endpoints are drawn over 2^scale ids and those >= V are rejected rather than folded, which
+// would pile extra degree onto the low ids. Duplicate pairs are redrawn.
+Graph GraphGenerator::generateRMAT() {
+    const double a = 0.57, b = 0.19, c = 0.19;
+    int V = config.vertices;
+    int scale = 0;
+    while ((1 << scale) < V)
+        ++scale;
+
+    Graph graph(V);
+    long long m = targetEdges(V, config.averageDegree);
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    // heavy-tailed draws repeat often on dense configs; give up on the remainder eventually
+    long long attempts = 64 * m;
+    for (long long added = 0; added < m && attempts > 0; --attempts) {
+        int u = 0, v = 0;
+        for (int bit = 0; bit < scale; ++bit) {
+            double r = coin(rng);
+            // quadrant a keeps both bits clear
+            if (r >= a + b + c) {
+                u |= 1 << bit;
+                v |= 1 << bit;
+            }
+            else if (r >= a + b) {
+                u |= 1 << bit;
+            }
+            else if (r >= a) {
+                v |= 1 << bit;
+            }
+        }
+        if (u < V && v < V && addUniqueEdge(graph, u, v))
+            ++added;
+    }
+    connectComponents(graph);
+    return graph;
+}
+
+Graph GraphGenerator::generateComplete() {
+    int V = config.vertices;
+    Graph graph(V);
+    for (int u = 0; u < V; ++u) {
+        for (int v = u + 1; v < V; ++v) {
+            graph.addEdge(u, v, nextWeight());
+        }
+    }
+    return graph;
+}
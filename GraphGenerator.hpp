@@ -0,0 +1,47 @@
+#ifndef GRAPH_GENERATOR_HPP
+#define GRAPH_GENERATOR_HPP
+
+#include "Graph.hpp"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_set>
+
+using namespace std;
+
+// Parameters for building a synthetic graph.
+// type:    "random" (Erdos-Renyi G(n,m)), "grid", "rmat" (power-law) or "complete"
+// weights: "uniform", "normal" or "exponential", scaled to [1, maxWeight]
+struct GeneratorConfig {
+    string type = "random";
+    int vertices = 1000;
+    double averageDegree = 8.0;
+    string weights = "uniform";
+    int maxWeight = 1000;
+    uint64_t seed = 42;
+};
+
+//This class builds synthetic graphs for benchmarking the MST strategies
+class GraphGenerator {
+public:
+    explicit GraphGenerator(const GeneratorConfig &config);
+
+    Graph generate();
+
+private:
+    GeneratorConfig config;
+    mt19937_64 rng;
+
+    // (min, max) endpoint pairs already in the graph being generated
+    unordered_set<uint64_t> existing;
+
+    int nextWeight();
+    bool addUniqueEdge(Graph &graph, int u, int v);
+    void connectComponents(Graph &graph);
+    Graph generateRandom();
+    Graph generateGrid();
+    Graph generateRMAT();
+    Graph generateComplete();
+};
+
+#endif // GRAPH_GENERATOR_HPP
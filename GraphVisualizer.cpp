@@ -4,7 +4,7 @@
 #include <iostream>
 #include <SFML/System.hpp>
 
-GraphVisualizer::GraphVisualizer(const Graph *g, const std::vector<std::pair<int, std::pair<int, int>>> *m): window(sf::VideoMode(800, 600), "Graph Visualizer"), graph(g), mst(m){
+void GraphVisualizer::setup(){
     if (!font.loadFromFile("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf")){
         throw std::runtime_error("Failed to load font");
     }
@@ -13,7 +13,6 @@ GraphVisualizer::GraphVisualizer(const Graph *g, const std::vector<std::pair<int
 }
 
 void GraphVisualizer::createVertices(){
-    int numVertices = graph->getNumVertices();
     float radius = 20.0f;
     float centerX = 400.0f;
     float centerY = 300.0f;
@@ -37,24 +36,20 @@ void GraphVisualizer::createVertices(){
 }
 
 void GraphVisualizer::createEdgesAndWeights(){
-    int numVertices = graph->getNumVertices();
-    for (int i = 0; i < numVertices; ++i){
-        for (const auto &edge : graph->getAdjacentEdges(i)){
-            int j = edge.first;
-            if (i < j){
-                sf::Vertex start(sf::Vector2f(vertices[i].getPosition().x + 20, vertices[i].getPosition().y + 20));
-                sf::Vertex end(sf::Vector2f(vertices[j].getPosition().x + 20, vertices[j].getPosition().y + 20));
-                start.color = sf::Color::Black;
-                end.color = sf::Color::Black;
-                edges.push_back(start);
-                edges.push_back(end);
-
-                sf::Text weight(std::to_string(edge.second), font, 15);
-                weight.setFillColor(sf::Color::Red);
-                weight.setPosition((start.position.x + end.position.x) / 2, (start.position.y + end.position.y) / 2);
-                edgeWeights.push_back(weight);
-            }
-        }
+    for (const auto &edge : graphEdges){
+        int i = get<0>(edge);
+        int j = get<1>(edge);
+        sf::Vertex start(sf::Vector2f(vertices[i].getPosition().x + 20, vertices[i].getPosition().y + 20));
+        sf::Vertex end(sf::Vector2f(vertices[j].getPosition().x + 20, vertices[j].getPosition().y + 20));
+        start.color = sf::Color::Black;
+        end.color = sf::Color::Black;
+        edges.push_back(start);
+        edges.push_back(end);
+
+        sf::Text weight(get<2>(edge), font, 15);
+        weight.setFillColor(sf::Color::Red);
+        weight.setPosition((start.position.x + end.position.x) / 2, (start.position.y + end.position.y) / 2);
+        edgeWeights.push_back(weight);
     }
 }
 
@@ -91,10 +86,10 @@ void GraphVisualizer::run(){
             window.draw(weight);
         }
 
-        if (mst){
-            for (const auto &edge : *mst){
-                int u = edge.second.first;
-                int v = edge.second.second;
+        if (!mstEdges.empty()){
+            for (const auto &edge : mstEdges){
+                int u = edge.first;
+                int v = edge.second;
                 sf::Vertex line[] = {
                     // Set the color of the MST edges to red
                     sf::Vertex(sf::Vector2f(vertices[u].getPosition().x + 20, vertices[u].getPosition().y + 20), sf::Color::Red),
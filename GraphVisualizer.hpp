@@ -2,6 +2,8 @@
 #define GRAPH_VISUALIZER_HPP
 
 #include <SFML/Graphics.hpp>
+#include <string>
+#include <tuple>
 #include "Graph.hpp"
 #include "MST.hpp"
 
@@ -11,19 +13,36 @@ class GraphVisualizer
 {
 private:
     sf::RenderWindow window;
-    const Graph *graph;
-    const vector<pair<int, pair<int, int>>> *mst;
+    int numVertices;
+    // (u, v, weight label) for every edge, and the MST edges drawn on top in red
+    vector<tuple<int, int, string>> graphEdges;
+    vector<pair<int, int>> mstEdges;
     vector<sf::CircleShape> vertices;
     vector<sf::Vertex> edges;
     vector<sf::Text> vertexLabels;
     vector<sf::Text> edgeWeights;
     sf::Font font;
 
+    void setup();
     void createVertices();
     void createEdgesAndWeights();
 
 public:
-    GraphVisualizer(const Graph *g, const vector<pair<int, pair<int, int>>> *m = nullptr);
+    // Accepts any graph instantiation; only positions and weight labels are kept
+    template <typename Index, typename Weight>
+    GraphVisualizer(const BasicGraph<Index, Weight> *g, const typename BasicMST<Index, Weight>::EdgeList *m = nullptr)
+        : window(sf::VideoMode(800, 600), "Graph Visualizer"), numVertices(g->getNumVertices())
+    {
+        for (const auto &edge : g->getEdges())
+            graphEdges.emplace_back(edge.second.first, edge.second.second, weightToString(widenWeight(edge.first)));
+        if (m)
+        {
+            for (const auto &edge : *m)
+                mstEdges.emplace_back(edge.second.first, edge.second.second);
+        }
+        setup();
+    }
+
     void run();
 };
 
@@ -0,0 +1,72 @@
+#ifndef JOB_CONTROL_HPP
+#define JOB_CONTROL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+
+using namespace std;
+
+// Thrown from a checkpoint of a cancelled job; the work it interrupted leaves no result behind
+class JobCancelled : public runtime_error
+{
+public:
+    JobCancelled() : runtime_error("Job cancelled") {}
+};
+
+//This class is the cooperative cancellation token and progress counter of one MST job.
+//Long loops call checkpoint() every few thousand steps and advance() with the work done;
+//a null JobControl (synchronous commands) skips both.
+class JobControl
+{
+public:
+    // How often, in loop iterations, strategies and measurements look at the token
+    static const size_t CHECK_INTERVAL = 4096;
+
+    void cancel() { cancelled.store(true, memory_order_relaxed); }
+    bool isCancelled() const { return cancelled.load(memory_order_relaxed); }
+    void checkpoint() const
+    {
+        if (isCancelled())
+            throw JobCancelled();
+    }
+
+    // Progress of the current phase: addWork() announces units, advance() completes them
+    void startPhase(const char *name)
+    {
+        total.store(0, memory_order_relaxed);
+        done.store(0, memory_order_relaxed);
+        phase.store(name, memory_order_release);
+    }
+    // nullptr until the first phase starts
+    const char *getPhase() const { return phase.load(memory_order_acquire); }
+    void addWork(size_t units) { total.fetch_add(units, memory_order_relaxed); }
+    void advance(size_t units) { done.fetch_add(units, memory_order_relaxed); }
+    double getProgress() const
+    {
+        size_t all = total.load(memory_order_relaxed);
+        return all ? min(1.0, static_cast<double>(done.load(memory_order_relaxed)) / all) : 0;
+    }
+
+private:
+    atomic<bool> cancelled{false};
+    atomic<const char *> phase{nullptr};
+    atomic<size_t> total{0};
+    atomic<size_t> done{0};
+};
+
+// Null-safe helpers for code that runs with and without a job
+inline void jobCheckpoint(const JobControl *control)
+{
+    if (control)
+        control->checkpoint();
+}
+
+inline void jobAdvance(JobControl *control, size_t units)
+{
+    if (control)
+        control->advance(units);
+}
+
+#endif // JOB_CONTROL_HPP
@@ -0,0 +1,149 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+using namespace std;
+
+LatencyHistogram::LatencyHistogram() : buckets(BUCKET_COUNT, 0), totalCount(0),
+      minValue(numeric_limits<uint64_t>::max()), maxValue(0) {}
+
+// Values below 2^SUB_BUCKET_BITS get a bucket each; above that, the top SUB_BUCKET_BITS
+// bits of the value select one of 64 sub-buckets of its power of two.
+size_t LatencyHistogram::bucketIndex(uint64_t valueNs) {
+    const uint64_t linearLimit = 1ULL << SUB_BUCKET_BITS;
+    if (valueNs < linearLimit)
+        return valueNs;
+
+    int msb = 63 - __builtin_clzll(valueNs);
+    int shift = msb - (SUB_BUCKET_BITS - 1);
+    uint64_t sub = (valueNs >> shift) - (linearLimit >> 1);
+    return linearLimit + (static_cast<size_t>(shift - 1) << (SUB_BUCKET_BITS - 1)) + sub;
+}
+
+uint64_t LatencyHistogram::bucketHighestValue(size_t index) {
+    const uint64_t linearLimit = 1ULL << SUB_BUCKET_BITS;
+    if (index < linearLimit)
+        return index;
+
+    size_t offset = index - linearLimit;
+    int shift = static_cast<int>(offset >> (SUB_BUCKET_BITS - 1)) + 1;
+    uint64_t sub = (offset & ((linearLimit >> 1) - 1)) + (linearLimit >> 1);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t valueNs, uint64_t count) {
+    buckets[bucketIndex(valueNs)] += count;
+    totalCount += count;
+    minValue = min(minValue, valueNs);
+    maxValue = max(maxValue, valueNs);
+}
+
+void LatencyHistogram::addToBucket(size_t index, uint64_t count) {
+    if (count == 0)
+        return;
+    buckets[index] += count;
+    totalCount += count;
+    minValue = min(minValue, index == 0 ? 0 : bucketHighestValue(index - 1) + 1);
+    maxValue = max(maxValue, bucketHighestValue(index));
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        buckets[i] += other.buckets[i];
+    totalCount += other.totalCount;
+    minValue = min(minValue, other.minValue);
+    maxValue = max(maxValue, other.maxValue);
+}
+
+void LatencyHistogram::reset() {
+    fill(buckets.begin(), buckets.end(), 0);
+    totalCount = 0;
+    minValue = numeric_limits<uint64_t>::max();
+    maxValue = 0;
+}
+
+uint64_t LatencyHistogram::getCount() const {
+    return totalCount;
+}
+
+uint64_t LatencyHistogram::getMin() const {
+    return totalCount ? minValue : 0;
+}
+
+uint64_t LatencyHistogram::getMax() const {
+    return maxValue;
+}
+
+double LatencyHistogram::getMean() const {
+    if (totalCount == 0)
+        return 0;
+    double sum = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        if (buckets[i])
+            sum += static_cast<double>(buckets[i]) * min(bucketHighestValue(i), maxValue);
+    return sum / totalCount;
+}
+
+double LatencyHistogram::getStdDeviation() const {
+    if (totalCount == 0)
+        return 0;
+    double mean = getMean();
+    double sq = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        if (buckets[i]) {
+            double d = min(bucketHighestValue(i), maxValue) - mean;
+            sq += d * d * buckets[i];
+        }
+    }
+    return sqrt(sq / totalCount);
+}
+
+uint64_t LatencyHistogram::getValueAtPercentile(double percentile) const {
+    if (totalCount == 0)
+        return 0;
+    uint64_t target = max<uint64_t>(1, static_cast<uint64_t>(ceil(percentile / 100.0 * totalCount)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets[i];
+        if (seen >= target)
+            return min(bucketHighestValue(i), maxValue);
+    }
+    return maxValue;
+}
+
+uint64_t LatencyHistogram::getCountAtOrBelow(uint64_t valueNs) const {
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT && bucketHighestValue(i) <= valueNs; ++i)
+        count += buckets[i];
+    return count;
+}
+
+void LatencyHistogram::printPercentileDistribution(ostream &os, double unitNs) const {
+    os << fixed;
+    os << setw(12) << "Value" << " " << setw(14) << "Percentile" << " " << setw(10) << "TotalCount"
+       << " " << setw(14) << "1/(1-Percentile)" << "\n\n";
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT && seen < totalCount; ++i) {
+        if (!buckets[i])
+            continue;
+        seen += buckets[i];
+        double fraction = static_cast<double>(seen) / totalCount;
+        os << setw(12) << setprecision(3) << min(bucketHighestValue(i), maxValue) / unitNs << " "
+           << setw(14) << setprecision(12) << fraction << " " << setw(10) << seen << " ";
+        if (seen < totalCount)
+            os << setw(14) << setprecision(2) << 1.0 / (1.0 - fraction);
+        os << "\n";
+    }
+
+    os << setprecision(3)
+       << "#[Mean    = " << setw(12) << getMean() / unitNs
+       << ", StdDeviation   = " << setw(12) << getStdDeviation() / unitNs << "]\n"
+       << "#[Max     = " << setw(12) << getMax() / unitNs
+       << ", Total count    = " << setw(12) << totalCount << "]\n"
+       << "#[Buckets = " << setw(12) << (64 - SUB_BUCKET_BITS + 2)
+       << ", SubBuckets     = " << setw(12) << (1 << (SUB_BUCKET_BITS - 1)) << "]\n";
+    os << defaultfloat;
+}
@@ -0,0 +1,48 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+//This class is a log-linear (HDR style) histogram of latencies in nanoseconds.
+//Every power of two is split into 64 linear sub-buckets, so any recorded value
+//is reported with at most ~1.6% relative error over the whole uint64_t range.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 7;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 2) << (SUB_BUCKET_BITS - 1);
+
+    LatencyHistogram();
+
+    void record(uint64_t valueNs, uint64_t count = 1);
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    uint64_t getCount() const;
+    uint64_t getMin() const;
+    uint64_t getMax() const;
+    double getMean() const;
+    double getStdDeviation() const;
+    uint64_t getValueAtPercentile(double percentile) const;
+    // Number of samples whose bucket lies entirely at or below valueNs
+    uint64_t getCountAtOrBelow(uint64_t valueNs) const;
+
+    // Writes the distribution in HdrHistogram's percentile text format, values scaled by 1/unitNs
+    void printPercentileDistribution(ostream &os, double unitNs = 1000.0) const;
+
+    // Bucket mapping shared with the lock-free counters in Metrics
+    static size_t bucketIndex(uint64_t valueNs);
+    static uint64_t bucketHighestValue(size_t index);
+    void addToBucket(size_t index, uint64_t count);
+
+private:
+    vector<uint64_t> buckets;
+    uint64_t totalCount;
+    uint64_t minValue;
+    uint64_t maxValue;
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
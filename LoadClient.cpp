@@ -0,0 +1,433 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "LatencyHistogram.hpp"
+
+using namespace std;
+
+// Load generator for the MST server: opens N connections and drives a weighted mix of
+// init / change_graph / kruskal / prim commands, then reports per-command latency.
+
+struct LoadOptions {
+    string host = "127.0.0.1";
+    int port = 9034;
+    int connections = 4;
+    double durationSec = 10;
+    string mode = "closed";         // "closed": next command after the reply, "open": fixed rate
+    double rate = 50;               // open loop: commands per second per connection
+    int vertices = 100;             // size of the graph sent by init
+    int edges = 400;
+    int burst = 10;                 // change_graph edits issued per picked change_graph
+    int maxWeight = 100;
+    vector<pair<string, double>> mix = {{"init", 1}, {"change_graph", 10}, {"kruskal", 2}, {"prim", 2}};
+    uint64_t seed = 1;
+};
+
+const vector<string> COMMAND_TYPES = {"init", "change_graph", "kruskal", "prim"};
+
+struct ConnectionStats {
+    map<string, LatencyHistogram> latency;
+    map<string, uint64_t> errors;
+    bool connected = false;
+    bool served = false;        // the greeting arrived before the deadline
+};
+
+// How a request/reply exchange ended
+enum class Outcome { OK, ERROR_REPLY, FAILED, TIMED_OUT };
+
+// Replies the server sends when it rejects a command instead of running it
+bool is_error_reply(const string &reply) {
+    return reply.rfind("Error:", 0) == 0 || reply.rfind("Invalid", 0) == 0 ||
+           reply.rfind("Please initialize", 0) == 0;
+}
+
+//This class speaks the line protocol: every server reply ends with the "\n> " prompt.
+//All waits are bounded by the run deadline so a stalled server cannot stretch the run.
+class ServerSession {
+public:
+    explicit ServerSession(chrono::steady_clock::time_point deadline) : fd(-1), deadline(deadline) {}
+    ~ServerSession() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool connectTo(const string &host, int port) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+            return false;
+        return connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    }
+
+    // The server greets only once a pool thread picks the connection up
+    Outcome awaitGreeting() {
+        // greeting + command list
+        return expectPrompts(2);
+    }
+
+    bool sendAll(const string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    // Consumes input until `count` prompts were seen; the text of the first reply goes to firstReply
+    Outcome expectPrompts(int count, string *firstReply = nullptr) {
+        static const string PROMPT = "\n> ";
+        size_t scanned = 0;
+        while (count > 0) {
+            size_t pos = pending.find(PROMPT, scanned);
+            if (pos != string::npos) {
+                if (firstReply) {
+                    firstReply->assign(pending, 0, pos);
+                    firstReply = nullptr;
+                }
+                pending.erase(0, pos + PROMPT.size());
+                scanned = 0;
+                --count;
+                continue;
+            }
+            // a prompt may be split across reads
+            scanned = pending.size() >= PROMPT.size() ? pending.size() - PROMPT.size() + 1 : 0;
+
+            auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+            if (remaining.count() <= 0)
+                return Outcome::TIMED_OUT;
+            pollfd readable{fd, POLLIN, 0};
+            int ready = poll(&readable, 1, static_cast<int>(remaining.count()));
+            if (ready < 0 && errno == EINTR)
+                continue;
+            if (ready < 0)
+                return Outcome::FAILED;
+            if (ready == 0)
+                return Outcome::TIMED_OUT;
+
+            char buffer[65536];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return Outcome::FAILED;
+            pending.append(buffer, n);
+        }
+        return Outcome::OK;
+    }
+
+private:
+    int fd;
+    chrono::steady_clock::time_point deadline;
+    string pending;
+};
+
+//This class runs the workload of a single connection
+class LoadWorker {
+public:
+    LoadWorker(const LoadOptions &options, int index, ConnectionStats &stats)
+        : options(options), stats(stats), rng(options.seed * 7919 + index) {
+        for (const auto &entry : options.mix)
+            weights.push_back(entry.second);
+    }
+
+    void run(chrono::steady_clock::time_point deadline) {
+        ServerSession session(deadline);
+        if (!session.connectTo(options.host, options.port)) {
+            stats.errors["connect"]++;
+            return;
+        }
+        stats.connected = true;
+        // a session still queued behind busy pool threads at the deadline was never served
+        Outcome greeting = session.awaitGreeting();
+        if (greeting != Outcome::OK) {
+            if (greeting == Outcome::FAILED)
+                stats.errors["connect"]++;
+            return;
+        }
+        stats.served = true;
+
+        // every session needs a graph before edits and solves make sense
+        if (!timed("init", [&]() { return sendInit(session); }, chrono::steady_clock::now()))
+            return;
+
+        discrete_distribution<size_t> pickCommand(weights.begin(), weights.end());
+        auto interval = chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(1.0 / options.rate));
+        auto intended = chrono::steady_clock::now();
+
+        while (chrono::steady_clock::now() < deadline) {
+            const string &command = options.mix[pickCommand(rng)].first;
+            int repeats = command == "change_graph" ? options.burst : 1;
+            for (int i = 0; i < repeats; ++i) {
+                auto start = chrono::steady_clock::now();
+                if (options.mode == "open") {
+                    if (intended >= deadline)
+                        break;
+                    // latency is taken from the intended send time to avoid coordinated omission
+                    this_thread::sleep_until(intended);
+                    start = intended;
+                    intended += interval;
+                }
+
+                bool ok;
+                if (command == "init")
+                    ok = timed(command, [&]() { return sendInit(session); }, start);
+                else if (command == "change_graph")
+                    ok = timed(command, [&]() { return sendEdit(session); }, start);
+                else
+                    ok = timed(command, [&]() { return sendSolve(session, command); }, start);
+                if (!ok)
+                    return;
+            }
+        }
+        session.sendAll("quit\n");
+    }
+
+private:
+    const LoadOptions &options;
+    ConnectionStats &stats;
+    mt19937_64 rng;
+    vector<double> weights;
+    vector<pair<int, int>> liveEdges;
+
+    // Runs one exchange and records its latency. Returns whether the session can go on:
+    // an error reply is counted but keeps the session, a broken or timed-out one ends it.
+    // Exchanges cut off by the deadline are neither latencies nor errors.
+    template <typename Body>
+    bool timed(const string &command, Body body, chrono::steady_clock::time_point start) {
+        Outcome outcome = body();
+        if (outcome == Outcome::TIMED_OUT)
+            return false;
+        if (outcome != Outcome::OK) {
+            stats.errors[command]++;
+            return outcome == Outcome::ERROR_REPLY;
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        stats.latency[command].record(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+        return true;
+    }
+
+    // Sends a request and waits for its prompts, checking the reply at `replyIndex` for a rejection
+    Outcome exchange(ServerSession &session, const string &request, int prompts, int replyIndex) {
+        if (!session.sendAll(request))
+            return Outcome::FAILED;
+        Outcome outcome = replyIndex > 0 ? session.expectPrompts(replyIndex) : Outcome::OK;
+        if (outcome != Outcome::OK)
+            return outcome;
+        string reply;
+        outcome = session.expectPrompts(prompts - replyIndex, &reply);
+        if (outcome == Outcome::OK && is_error_reply(reply))
+            return Outcome::ERROR_REPLY;
+        return outcome;
+    }
+
+    int randomWeight() {
+        return uniform_int_distribution<int>(1, options.maxWeight)(rng);
+    }
+
+    // A path through all vertices keeps the graph connected, the rest of the edges are random
+    Outcome sendInit(ServerSession &session) {
+        int V = max(2, options.vertices);
+        int E = max(V - 1, options.edges);
+        uniform_int_distribution<int> pick(0, V - 1);
+
+        liveEdges.clear();
+        ostringstream oss;
+        oss << "init\n" << V << " " << E << "\n";
+        for (int i = 0; i < E; ++i) {
+            int u = i < V - 1 ? i : pick(rng);
+            int v = i < V - 1 ? i + 1 : pick(rng);
+            if (u == v)
+                v = (v + 1) % V;
+            oss << u << " " << v << " " << randomWeight() << "\n";
+            if (i >= V - 1)
+                liveEdges.push_back({u, v});
+        }
+        // prompts: counts, edges, initialized, options
+        return exchange(session, oss.str(), 4, 2);
+    }
+
+    // Alternates between adding random edges and removing previously added ones
+    Outcome sendEdit(ServerSession &session) {
+        int V = max(2, options.vertices);
+        uniform_int_distribution<int> pick(0, V - 1);
+        ostringstream oss;
+        if (!liveEdges.empty() && rng() % 2) {
+            size_t index = rng() % liveEdges.size();
+            auto edge = liveEdges[index];
+            liveEdges[index] = liveEdges.back();
+            liveEdges.pop_back();
+            oss << "change_graph\nremove_edge\n" << edge.first << " " << edge.second << "\n";
+        }
+        else {
+            int u = pick(rng);
+            int v = (u + 1 + rng() % (V - 1)) % V;
+            liveEdges.push_back({u, v});
+            oss << "change_graph\nadd_edge\n" << u << " " << v << " " << randomWeight() << "\n";
+        }
+        // prompts: subcommand list, argument format, result, options
+        return exchange(session, oss.str(), 4, 2);
+    }
+
+    // prompts: result (or "Error: ..."), options
+    Outcome sendSolve(ServerSession &session, const string &strategy) {
+        return exchange(session, strategy + "\n", 2, 0);
+    }
+};
+
+void print_usage(const char *prog) {
+    cerr << "Usage: " << prog << " [--host H] [--port P] [--connections N] [--duration SEC]\n"
+         << "       [--mode closed|open] [--rate OPS_PER_SEC_PER_CONNECTION]\n"
+         << "       [--vertices V] [--edges E] [--burst B] [--max-weight W]\n"
+         << "       [--mix init:1,change_graph:10,kruskal:2,prim:2] [--seed S]" << endl;
+}
+
+bool parse_mix(const string &value, vector<pair<string, double>> &mix) {
+    mix.clear();
+    string item;
+    istringstream iss(value);
+    while (getline(iss, item, ',')) {
+        size_t colon = item.find(':');
+        string name = item.substr(0, colon);
+        if (find(COMMAND_TYPES.begin(), COMMAND_TYPES.end(), name) == COMMAND_TYPES.end()) {
+            cerr << "Unknown command in mix: " << name << endl;
+            return false;
+        }
+        mix.push_back({name, colon == string::npos ? 1.0 : stod(item.substr(colon + 1))});
+    }
+    return !mix.empty();
+}
+
+bool parse_options(int argc, char *argv[], LoadOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "--host")
+            options.host = value;
+        else if (arg == "--port")
+            options.port = stoi(value);
+        else if (arg == "--connections")
+            options.connections = max(1, stoi(value));
+        else if (arg == "--duration")
+            options.durationSec = stod(value);
+        else if (arg == "--mode" && (value == "open" || value == "closed"))
+            options.mode = value;
+        else if (arg == "--rate")
+            options.rate = max(0.001, stod(value));
+        else if (arg == "--vertices")
+            options.vertices = stoi(value);
+        else if (arg == "--edges")
+            options.edges = stoi(value);
+        else if (arg == "--burst")
+            options.burst = max(1, stoi(value));
+        else if (arg == "--max-weight")
+            options.maxWeight = max(1, stoi(value));
+        else if (arg == "--mix") {
+            if (!parse_mix(value, options.mix))
+                return false;
+        }
+        else if (arg == "--seed")
+            options.seed = stoull(value);
+        else {
+            cerr << "Unknown option " << arg << " " << value << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    LoadOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    cout << "Driving " << options.host << ":" << options.port << " with " << options.connections
+         << " connections (" << options.mode << " loop) for " << options.durationSec << "s" << endl;
+
+    vector<ConnectionStats> stats(options.connections);
+    vector<thread> workers;
+    auto start = chrono::steady_clock::now();
+    auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                chrono::duration<double>(options.durationSec));
+    for (int i = 0; i < options.connections; ++i) {
+        workers.emplace_back([&options, &stats, i, deadline]() {
+            LoadWorker(options, i, stats[i]).run(deadline);
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    // only exchanges finished before the deadline are counted, so rates use the configured window
+    double elapsed = options.durationSec;
+
+    map<string, LatencyHistogram> total;
+    map<string, uint64_t> errors;
+    int neverServed = 0;
+    for (const auto &connection : stats) {
+        if (connection.connected && !connection.served)
+            ++neverServed;
+        for (const auto &entry : connection.latency)
+            total[entry.first].merge(entry.second);
+        for (const auto &entry : connection.errors)
+            errors[entry.first] += entry.second;
+    }
+
+    cout << "\n" << left << setw(14) << "command" << right << setw(10) << "count" << setw(12) << "ops/s"
+         << setw(12) << "p50 ms" << setw(12) << "p99 ms" << setw(12) << "p999 ms" << setw(12) << "max ms"
+         << setw(8) << "errors" << "\n";
+    uint64_t allOps = 0;
+    for (const auto &command : COMMAND_TYPES) {
+        const LatencyHistogram &h = total[command];
+        allOps += h.getCount();
+        cout << left << setw(14) << command << right << setw(10) << h.getCount() << fixed << setprecision(1)
+             << setw(12) << h.getCount() / elapsed << setprecision(3)
+             << setw(12) << h.getValueAtPercentile(50) / 1e6 << setw(12) << h.getValueAtPercentile(99) / 1e6
+             << setw(12) << h.getValueAtPercentile(99.9) / 1e6 << setw(12) << h.getMax() / 1e6
+             << setw(8) << errors[command] << defaultfloat << "\n";
+    }
+    if (errors["connect"])
+        cout << "connect errors: " << errors["connect"] << "\n";
+    if (neverServed)
+        cout << "sessions never served (no greeting before the deadline): " << neverServed << "\n";
+    cout << "total throughput: " << fixed << setprecision(1) << allOps / elapsed << " ops/s\n" << defaultfloat;
+
+    for (const auto &command : COMMAND_TYPES) {
+        if (total[command].getCount() == 0)
+            continue;
+        cout << "\n# " << command << " latency distribution (milliseconds)\n";
+        total[command].printPercentileDistribution(cout, 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "Logger.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+atomic<int> Logger::currentLevel(LOG_LEVEL_INFO);
+
+namespace {
+
+const size_t RING_CAPACITY = 1024;     // records per thread, power of two
+const size_t RECORD_TEXT = 240;
+
+const char *LEVEL_NAMES[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+struct LogRecord {
+    uint64_t timeNs;
+    int level;
+    uint32_t length;
+    char text[RECORD_TEXT];
+};
+
+// Single producer (the owning thread), single consumer (the drain thread)
+struct LogRing {
+    LogRecord records[RING_CAPACITY];
+    alignas(64) atomic<uint64_t> head{0};
+    alignas(64) atomic<uint64_t> tail{0};
+    atomic<uint64_t> dropped{0};
+    uint32_t threadIndex = 0;
+    // set when the owning thread exits; the ring is reused once it is also empty
+    atomic<bool> retired{false};
+
+    // rate limiting state, touched by the producer only
+    uint64_t windowStartNs = 0;
+    uint32_t windowCount = 0;
+};
+
+uint64_t nowNs() {
+    static const auto start = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+//This class owns the rings and the drain thread; it lives until static destruction
+class LogDrain {
+public:
+    LogDrain() : running(true), rateLimit(10000), reportedDrops(0), drainer([this]() { run(); }) {}
+
+    ~LogDrain() {
+        running = false;
+        drainer.join();
+        drainOnce();
+    }
+
+    // Hands out a ring whose thread has exited and whose records are all written, so short-lived
+    // threads do not grow rings; otherwise a new one
+    LogRing *registerThread() {
+        lock_guard<mutex> lock(ringsMutex);
+        for (auto &ring : rings) {
+            // tail only moves under ringsMutex, and a retired ring's head no longer moves
+            if (ring->retired.load(memory_order_acquire) &&
+                ring->tail.load(memory_order_relaxed) == ring->head.load(memory_order_relaxed)) {
+                ring->retired.store(false, memory_order_relaxed);
+                ring->windowStartNs = 0;
+                ring->windowCount = 0;
+                return ring.get();
+            }
+        }
+        auto ring = make_unique<LogRing>();
+        LogRing *raw = ring.get();
+        raw->threadIndex = static_cast<uint32_t>(rings.size());
+        rings.push_back(move(ring));
+        return raw;
+    }
+
+    void flush() {
+        unique_lock<mutex> lock(flushMutex);
+        uint64_t target = drainedPasses + 2;
+        flushed.wait_for(lock, chrono::seconds(1), [&]() { return drainedPasses >= target || !running; });
+    }
+
+    uint64_t droppedCount() {
+        uint64_t total = 0;
+        lock_guard<mutex> lock(ringsMutex);
+        for (const auto &ring : rings)
+            total += ring->dropped.load(memory_order_relaxed);
+        return total;
+    }
+
+    atomic<bool> running;
+    atomic<uint32_t> rateLimit;
+
+private:
+    mutex ringsMutex;
+    vector<unique_ptr<LogRing>> rings;
+    uint64_t reportedDrops;
+    string output;
+
+    mutex flushMutex;
+    condition_variable flushed;
+    uint64_t drainedPasses = 0;
+
+    thread drainer;
+
+    size_t drainOnce() {
+        size_t drained = 0;
+        uint64_t drops = 0;
+        {
+            lock_guard<mutex> lock(ringsMutex);
+            for (auto &ring : rings) {
+                uint64_t tail = ring->tail.load(memory_order_relaxed);
+                uint64_t head = ring->head.load(memory_order_acquire);
+                for (; tail != head; ++tail, ++drained) {
+                    const LogRecord &record = ring->records[tail & (RING_CAPACITY - 1)];
+                    char prefix[64];
+                    int n = snprintf(prefix, sizeof(prefix), "[%s %llu.%06llu t%u] ", LEVEL_NAMES[record.level],
+                                     static_cast<unsigned long long>(record.timeNs / 1000000000ULL),
+                                     static_cast<unsigned long long>(record.timeNs / 1000 % 1000000),
+                                     ring->threadIndex);
+                    output.append(prefix, n);
+                    output.append(record.text, record.length);
+                    output.push_back('\n');
+                }
+                ring->tail.store(tail, memory_order_release);
+                drops += ring->dropped.load(memory_order_relaxed);
+            }
+        }
+
+        if (drops > reportedDrops) {
+            output += "[WARN] logger dropped " + to_string(drops - reportedDrops) + " messages\n";
+            reportedDrops = drops;
+        }
+        if (!output.empty()) {
+            fwrite(output.data(), 1, output.size(), stdout);
+            fflush(stdout);
+            output.clear();
+        }
+        return drained;
+    }
+
+    void run() {
+        while (running) {
+            size_t drained = drainOnce();
+            {
+                lock_guard<mutex> lock(flushMutex);
+                ++drainedPasses;
+            }
+            flushed.notify_all();
+            // producers never signal us (that would cost them a syscall), so poll while idle
+            if (drained == 0)
+                this_thread::sleep_for(chrono::milliseconds(2));
+        }
+    }
+};
+
+LogDrain &drain() {
+    static LogDrain instance;
+    return instance;
+}
+
+// A thread's hold on its ring, given back when the thread exits
+struct RingOwner {
+    LogRing *ring;
+
+    RingOwner() : ring(drain().registerThread()) {}
+    ~RingOwner() { ring->retired.store(true, memory_order_release); }
+};
+
+LogRing &localRing() {
+    thread_local RingOwner owner;
+    return *owner.ring;
+}
+
+} // namespace
+
+void Logger::setLevel(int level) {
+    currentLevel.store(level, memory_order_relaxed);
+}
+
+int Logger::getLevel() {
+    return currentLevel.load(memory_order_relaxed);
+}
+
+void Logger::setRateLimit(uint32_t messagesPerSecond) {
+    drain().rateLimit.store(messagesPerSecond, memory_order_relaxed);
+}
+
+void Logger::write(int level, const char *format, ...) {
+    LogRing &ring = localRing();
+    uint64_t now = nowNs();
+
+    uint32_t limit = drain().rateLimit.load(memory_order_relaxed);
+    if (limit) {
+        if (now - ring.windowStartNs >= 1000000000ULL) {
+            ring.windowStartNs = now;
+            ring.windowCount = 0;
+        }
+        if (++ring.windowCount > limit) {
+            ring.dropped.store(ring.dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    if (head - ring.tail.load(memory_order_acquire) >= RING_CAPACITY) {
+        ring.dropped.store(ring.dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        return;
+    }
+
+    LogRecord &record = ring.records[head & (RING_CAPACITY - 1)];
+    record.timeNs = now;
+    record.level = level < LOG_LEVEL_DEBUG ? LOG_LEVEL_DEBUG : (level > LOG_LEVEL_ERROR ? LOG_LEVEL_ERROR : level);
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(record.text, RECORD_TEXT, format, args);
+    va_end(args);
+    record.length = n < 0 ? 0 : (static_cast<size_t>(n) >= RECORD_TEXT ? RECORD_TEXT - 1 : n);
+
+    ring.head.store(head + 1, memory_order_release);
+}
+
+void Logger::flush() {
+    drain().flush();
+}
+
+uint64_t Logger::getDroppedCount() {
+    return drain().droppedCount();
+}
@@ -0,0 +1,58 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+// Levels below LOG_COMPILE_LEVEL are compiled out entirely (see LOG_LEVEL in the makefile)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+//This class is an asynchronous logger for the server's hot paths.
+//Each thread formats its message into its own lock-free single-producer ring buffer;
+//a background thread drains all rings to the output. A full ring or an exceeded
+//per-thread rate limit drops the message instead of blocking the caller.
+class Logger {
+public:
+    static void setLevel(int level);
+    static int getLevel();
+
+    // Maximum number of messages a single thread may log per second (0 = unlimited)
+    static void setRateLimit(uint32_t messagesPerSecond);
+
+    static void write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Blocks until everything logged so far has been written
+    static void flush();
+
+    static uint64_t getDroppedCount();
+
+    static bool isEnabled(int level) {
+        return level >= currentLevel.load(std::memory_order_relaxed);
+    }
+
+private:
+    static std::atomic<int> currentLevel;
+};
+
+#define LOG_AT(level, ...)                                          \
+    do {                                                            \
+        if constexpr ((level) >= LOG_COMPILE_LEVEL) {               \
+            if (Logger::isEnabled(level))                           \
+                Logger::write((level), __VA_ARGS__);                \
+        }                                                           \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif // LOGGER_HPP
@@ -2,15 +2,24 @@
 #define MST_HPP
 
 #include "Graph.hpp"
+#include "JobControl.hpp"
 #include "vector"
 
 using namespace std;
 
-class MST
+template <typename Index, typename Weight>
+class BasicMST
 {
 public:
-    virtual vector<pair<int, pair<int, int>>> computeMST(const Graph &graph) = 0;
-    virtual ~MST() = default;
+    using GraphType = BasicGraph<Index, Weight>;
+    using EdgeList = vector<pair<Weight, pair<Index, Index>>>;
+
+    // control, when given, is checked for cancellation and told the progress
+    virtual EdgeList computeMST(const GraphType &graph, JobControl *control) = 0;
+    EdgeList computeMST(const GraphType &graph) { return computeMST(graph, nullptr); }
+    virtual ~BasicMST() = default;
 };
 
+using MST = BasicMST<int, int>;
+
 #endif // MST_HPP
@@ -1,208 +1,602 @@
 #include "MSTServer.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
 #include <algorithm>
-#include <numeric>
-#include <queue>
-#include <limits>
+#include <stdexcept>
+#include <unordered_set>
 
-MSTServer::MSTServer(int num_threads) 
-    : strategyFactory(make_unique<ConcreteStrategyFactory>()),
-      threadPool(make_unique<ThreadPoll>(num_threads)) {}
+namespace {
+
+// What one edit may add at most without growing a list: an edge in both lists of the widest
+// instantiation, or a vertex's empty list
+const size_t GROWTH_PER_EDIT = 32;
+
+size_t resultBytes(const MSTMeasurements &result) {
+    return sizeof(MSTMeasurements) + result.components.capacity() * sizeof(ComponentMeasurements);
+}
+
+string kibibytes(size_t bytes) {
+    return to_string((bytes + 1023) >> 10) + " KiB";
+}
+
+} // namespace
+
+MSTServer::MSTServer(int num_threads, PinPolicy pin, bool nodeLocal, size_t firstCpu)
+    : threadPool(make_unique<ThreadPoll>(num_threads, pin, nodeLocal, firstCpu)) {}
+
+MSTServer::~MSTServer() {
+    {
+        lock_guard<mutex> lock(stateMutex);
+        for (auto &entry : jobs)
+            entry.second->control.cancel();
+    }
+    // running jobs refer to the server, so stop them before any member goes away
+    threadPool.reset();
+}
+
+void MSTServer::setGraph(int clientId, unique_ptr<ClientGraph> newGraph) {
+    LOG_DEBUG("Client %d graph stored as %s", clientId, newGraph->getTypeName().c_str());
+    lock_guard<mutex> lock(stateMutex);
+    size_t bytes = newGraph->getMemoryUsage().total();
+    checkQuota(clientId, bytes, bytes, true);
+    clientGraphs[clientId] = move(newGraph);
+    measurements.erase(clientId);
+}
 
 void MSTServer::setGraph(int clientId, const Graph &newGraph) {
-    clientGraphs[clientId] = make_unique<Graph>(newGraph);
+    setGraph(clientId, ClientGraph::fromGraph(newGraph, duplicatePolicy));
 }
 
-void MSTServer::updateGraph(int clientId, const vector<pair<int, pair<int, int>>> &changes) {
-    if (clientGraphs.find(clientId) == clientGraphs.end()) {
+void MSTServer::setPoints(int clientId, vector<EuclideanMST::Point> points) {
+    int count = static_cast<int>(points.size());
+    EuclideanMST::EdgeList tree;
+    {
+        ScopedTimer timer(Metrics::STAGE_SOLVE_MST);
+        tree = EuclideanMST(move(points)).compute(*threadPool);
+    }
+    vector<ClientGraph::EdgeInput> edges;
+    edges.reserve(tree.size());
+    for (const auto &edge : tree)
+        edges.push_back({edge.second.first, edge.second.second, WeightValue(edge.first)});
+    unique_ptr<ClientGraph> graph = ClientGraph::create(count, edges, duplicatePolicy);
+    // the graph is the tree itself, so it is its own spanning forest
+    graph->restoreForest(edges, *threadPool);
+    setGraph(clientId, move(graph));
+}
+
+bool MSTServer::hasGraph(int clientId) const {
+    lock_guard<mutex> lock(stateMutex);
+    return clientGraphs.count(clientId) > 0;
+}
+
+// The returned reference stays valid until the client sets, widens or drops its graph
+ClientGraph &MSTServer::getGraph(int clientId) {
+    lock_guard<mutex> lock(stateMutex);
+    auto it = clientGraphs.find(clientId);
+    if (it == clientGraphs.end()) {
         throw runtime_error("Client graph not found");
     }
+    return *it->second;
+}
 
-    for (const auto &change : changes) {
-        int weight = change.first;
-        int u = change.second.first;
-        int v = change.second.second;
-        clientGraphs[clientId]->addEdge(u, v, weight);
+void MSTServer::removeClient(int clientId) {
+    lock_guard<mutex> lock(stateMutex);
+    clientGraphs.erase(clientId);
+    measurements.erase(clientId);
+    activity.erase(clientId);
+    dropExpiredNames();
+    // nobody is left to collect these results, so stop computing them
+    for (auto it = jobs.begin(); it != jobs.end();) {
+        if (it->second->clientId == clientId) {
+            it->second->control.cancel();
+            it = jobs.erase(it);
+        }
+        else {
+            ++it;
+        }
     }
 }
 
-void MSTServer::solveMST(int clientId, const std::string &strategyName) {
-    if (clientGraphs.find(clientId) == clientGraphs.end()) {
-        throw runtime_error("Client graph not found");
+void MSTServer::publishGraph(int clientId, const string &name) {
+    shared_ptr<ClientGraph> graph;
+    bool added;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        auto it = clientGraphs.find(clientId);
+        if (it == clientGraphs.end()) {
+            throw runtime_error("Client graph not found");
+        }
+        dropExpiredNames();
+        auto existing = namedGraphs.find(name);
+        if (existing != namedGraphs.end() && existing->second.lock() != it->second) {
+            throw runtime_error("Graph name already in use: " + name);
+        }
+        graph = it->second;
+        graph->markPublished();
+        added = existing == namedGraphs.end();
+        namedGraphs[name] = graph;
     }
+    // copied outside the lock: flattening waits for any solve running on the graph
+    if (sharedStore) {
+        try {
+            sharedStore->publish(name, *graph);
+        }
+        catch (const exception &) {
+            lock_guard<mutex> lock(stateMutex);
+            if (added)
+                namedGraphs.erase(name);
+            throw;
+        }
+    }
+    LOG_INFO("Client %d published its graph as '%s'", clientId, name.c_str());
+}
 
-    auto strategy = strategyFactory->createStrategy(strategyName);
-    clientMSTResults[clientId] = strategy->computeMST(*clientGraphs[clientId]);
+void MSTServer::dropExpiredNames() {
+    for (auto named = namedGraphs.begin(); named != namedGraphs.end();) {
+        if (named->second.expired()) {
+            // a no-op for names this worker only attached to
+            if (sharedStore)
+                sharedStore->unpublish(named->first);
+            named = namedGraphs.erase(named);
+        }
+        else {
+            ++named;
+        }
+    }
 }
 
-void MSTServer::calculateMeasurements(int clientId) {
-    calculateTotalWeight(clientId);
-    calculateLongestDistance(clientId);
-    calculateAverageDistance(clientId);
-    calculateShortestMSTDistance(clientId);
+void MSTServer::attachGraph(int clientId, const string &name) {
+    shared_ptr<ClientGraph> graph;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        auto named = namedGraphs.find(name);
+        if (named != namedGraphs.end())
+            graph = named->second.lock();
+    }
+    // published by another worker: this worker loads one copy and shares it like its own
+    unique_ptr<ClientGraph> loaded;
+    if (!graph && sharedStore) {
+        loaded = sharedStore->load(name, *threadPool);
+        if (loaded)
+            loaded->markPublished();
+    }
+
+    lock_guard<mutex> lock(stateMutex);
+    if (!graph && loaded) {
+        weak_ptr<ClientGraph> &named = namedGraphs[name];
+        graph = named.lock();
+        if (!graph) {
+            graph = move(loaded);
+            named = graph;
+        }
+    }
+    if (!graph) {
+        throw runtime_error("No published graph named " + name);
+    }
+    long holders = 1;
+    for (const auto &entry : clientGraphs) {
+        if (entry.second == graph && entry.first != clientId)
+            ++holders;
+    }
+    size_t bytes = graph->getMemoryUsage().total();
+    // a graph this worker already shares costs the server nothing more
+    checkQuota(clientId, bytes / holders, holders > 1 || !loaded ? 0 : bytes, true);
+    clientGraphs[clientId] = graph;
+    measurements.erase(clientId);
+    LOG_INFO("Client %d attached to graph '%s' (%ld holders)", clientId, name.c_str(), graph.use_count() - 1);
 }
 
-void MSTServer::visualizeGraph(int clientId) const {
-    if (clientGraphs.find(clientId) == clientGraphs.end()) {
+// The client's graph, forked first when it is published and so shared read-only. growth is
+// what the edit may add; it and any fork are checked against the quotas first.
+ClientGraph &MSTServer::editableGraph(int clientId, size_t growth) {
+    lock_guard<mutex> lock(stateMutex);
+    auto it = clientGraphs.find(clientId);
+    if (it == clientGraphs.end()) {
         throw runtime_error("Client graph not found");
     }
+    // shared with attached sessions or with a running job
+    bool fork = it->second->isPublished() || it->second.use_count() > 1;
+    if (fork) {
+        // the private copy is charged to the client in full
+        size_t bytes = it->second->getMemoryUsage().total() + growth;
+        checkQuota(clientId, bytes, bytes, true);
+    }
+    else if (growth > 0) {
+        checkQuota(clientId, growth, growth, false);
+    }
+    if (fork) {
+        it->second = it->second->clone();
+        LOG_INFO("Client %d forked a private copy of a shared graph", clientId);
+    }
+    return *it->second;
+}
 
-    GraphVisualizer visualizer(clientGraphs.at(clientId).get(), nullptr);
-    visualizer.run();
+void MSTServer::setSharedStore(SharedGraphStore *store) {
+    sharedStore = store;
 }
 
-void MSTServer::visualizeMST(int clientId) const {
-    if (clientGraphs.find(clientId) == clientGraphs.end() || clientMSTResults.find(clientId) == clientMSTResults.end()) {
-        throw runtime_error("Client graph or MST result not found");
-    }
+void MSTServer::setVisualization(bool enabled) {
+    visualizationEnabled = enabled;
+}
+
+bool MSTServer::hasVisualization() const {
+    return visualizationEnabled;
+}
+
+void MSTServer::setDuplicatePolicy(DuplicatePolicy policy) {
+    duplicatePolicy = policy;
+}
+
+DuplicatePolicy MSTServer::getDuplicatePolicy() const {
+    return duplicatePolicy;
+}
+
+void MSTServer::setCompactionThreshold(double fraction) {
+    compactionThreshold = fraction;
+}
+
+void MSTServer::setMemoryQuotas(size_t perClient, size_t total) {
+    clientQuota = perClient;
+    totalQuota = total;
+}
+
+size_t MSTServer::getClientQuota() const {
+    return clientQuota;
+}
+
+size_t MSTServer::getTotalQuota() const {
+    return totalQuota;
+}
+
+void MSTServer::reserveGraph(int clientId, int vertices, size_t edges) const {
+    using Narrowest = BasicGraph<uint16_t, uint16_t>;
+    size_t bytes = static_cast<size_t>(vertices) * sizeof(vector<Narrowest::Neighbor>) +
+                   2 * edges * sizeof(Narrowest::Neighbor);
+    lock_guard<mutex> lock(stateMutex);
+    checkQuota(clientId, bytes, bytes, true);
+}
+
+ClientMemoryUsage MSTServer::getClientMemory(int clientId) const {
+    lock_guard<mutex> lock(stateMutex);
+    return usageOf(clientId);
+}
 
-    GraphVisualizer visualizer(clientGraphs.at(clientId).get(), &clientMSTResults.at(clientId));
-    visualizer.run();
+size_t MSTServer::getTotalMemory() const {
+    lock_guard<mutex> lock(stateMutex);
+    return totalUsage();
 }
 
-void MSTServer::calculateTotalWeight(int clientId) {
-    if (clientMSTResults.find(clientId) == clientMSTResults.end()) {
-        throw runtime_error("MST result not found");
+ClientMemoryUsage MSTServer::usageOf(int clientId) const {
+    ClientMemoryUsage usage;
+    auto it = clientGraphs.find(clientId);
+    if (it != clientGraphs.end()) {
+        usage.graph = it->second->getMemoryUsage();
+        for (const auto &entry : clientGraphs) {
+            if (entry.second == it->second)
+                ++usage.holders;
+        }
     }
+    auto result = measurements.find(clientId);
+    if (result != measurements.end())
+        usage.results += resultBytes(result->second);
+    for (const auto &entry : jobs) {
+        if (entry.second->clientId == clientId && entry.second->state == MSTJob::DONE)
+            usage.results += resultBytes(entry.second->result);
+    }
+    return usage;
+}
 
-    totalWeight[clientId] = std::accumulate(clientMSTResults[clientId].begin(), clientMSTResults[clientId].end(), 0,
-        [](int sum, const auto &edge) { return sum + edge.first; });
+size_t MSTServer::totalUsage() const {
+    unordered_set<const ClientGraph *> counted;
+    size_t total = 0;
+    for (const auto &entry : clientGraphs) {
+        if (counted.insert(entry.second.get()).second)
+            total += entry.second->getMemoryUsage().total();
+    }
+    for (const auto &entry : jobs) {
+        // a running job may hold a graph its client has since replaced
+        const MSTJob &job = *entry.second;
+        if (job.graph && counted.insert(job.graph.get()).second)
+            total += job.graph->getMemoryUsage().total();
+        if (job.state == MSTJob::DONE)
+            total += resultBytes(job.result);
+    }
+    for (const auto &entry : measurements)
+        total += resultBytes(entry.second);
+    return total;
 }
 
-void MSTServer::calculateLongestDistance(int clientId) {
-    if (clientMSTResults.find(clientId) == clientMSTResults.end()) {
-        throw runtime_error("MST result not found");
+void MSTServer::checkQuota(int clientId, size_t clientBytes, size_t serverBytes, bool replacing) const {
+    if (clientQuota == 0 && totalQuota == 0)
+        return;
+    ClientMemoryUsage usage = usageOf(clientId);
+    size_t client = replacing ? clientBytes + usage.results : usage.charged() + clientBytes;
+    // the replaced graph is still held while its successor is built
+    size_t total = totalUsage() + serverBytes;
+    if (clientQuota && client > clientQuota) {
+        Metrics::add(Metrics::QUOTA_REJECTIONS);
+        throw runtime_error("Memory quota exceeded: the client would hold " + kibibytes(client) + " of " +
+                            kibibytes(clientQuota));
     }
+    if (totalQuota && total > totalQuota) {
+        Metrics::add(Metrics::QUOTA_REJECTIONS);
+        throw runtime_error("Server memory quota exceeded: " + kibibytes(total) + " of " + kibibytes(totalQuota));
+    }
+}
 
-    const auto &mst = clientMSTResults[clientId];
-    int V = clientGraphs[clientId]->getNumVertices();
+void MSTServer::beginCommand(int clientId) {
+    unique_lock<mutex> lock(stateMutex);
+    ClientActivity &client = activity[clientId];
+    compactionDone.wait(lock, [&client] { return !client.compacting; });
+    ++client.commands;
+}
+
+void MSTServer::endCommand(int clientId) {
+    lock_guard<mutex> lock(stateMutex);
+    auto it = activity.find(clientId);
+    if (it == activity.end())
+        return;
+    --it->second.commands;
+    it->second.lastUsed = chrono::steady_clock::now();
+    it->second.trimmed = false;
+}
 
-    // ניצור גרף המייצג את ה-MST
-    vector<vector<pair<int, int>>> adjList(V);
-    for (const auto &edge : mst) {
-        int u = edge.second.first;
-        int v = edge.second.second;
-        int weight = edge.first;
-        adjList[u].emplace_back(v, weight);
-        adjList[v].emplace_back(u, weight);
+// Only a graph that is neither published nor held by a job, whose client is between
+// commands, is trimmed; its client's next command waits until the trim is done
+size_t MSTServer::compactIdleGraphs(chrono::steady_clock::duration idleFor) {
+    vector<pair<int, shared_ptr<ClientGraph>>> idle;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        auto now = chrono::steady_clock::now();
+        for (const auto &entry : clientGraphs) {
+            auto it = activity.find(entry.first);
+            if (it == activity.end() || it->second.commands > 0 || it->second.trimmed ||
+                now - it->second.lastUsed < idleFor)
+                continue;
+            if (entry.second->isPublished() || entry.second.use_count() > 1)
+                continue;
+            it->second.compacting = true;
+            idle.push_back(entry);
+        }
     }
+    if (idle.empty())
+        return 0;
+
+    size_t released = 0;
+    {
+        ScopedTimer timer(Metrics::STAGE_COMPACT);
+        for (auto &entry : idle)
+            released += entry.second->trimMemory();
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        for (auto &entry : idle) {
+            auto it = activity.find(entry.first);
+            if (it == activity.end())
+                continue;
+            it->second.compacting = false;
+            it->second.trimmed = true;
+        }
+    }
+    compactionDone.notify_all();
+    Metrics::add(Metrics::TRIMMED_BYTES, static_cast<int64_t>(released));
+    LOG_INFO("Idle compaction trimmed %zu graphs, releasing %zu bytes", idle.size(), released);
+    return released;
+}
 
-    // פונקציה למציאת הקודקוד הרחוק ביותר מ-start
-    auto findFurthestNode = [&](int start) {
-        vector<int> dist(V, numeric_limits<int>::max());
-        dist[start] = 0;
-        priority_queue<pair<int, int>, vector<pair<int, int>>, greater<>> pq;
-        pq.push({0, start});
-        
-        int furthestNode = start;
-        int maxDistance = 0;
+// Rebuilds the client's graph with room for `vertices` and the extra edges; the MST is dropped
+void MSTServer::widenGraph(int clientId, int vertices, const vector<ClientGraph::EdgeInput> &extraEdges) {
+    ClientGraph &graph = getGraph(clientId);
+    auto edges = graph.getEdges();
+    edges.insert(edges.end(), extraEdges.begin(), extraEdges.end());
+    auto wider = ClientGraph::create(max(vertices, graph.getNumVertices()), edges, graph.getDuplicatePolicy());
+    // removed ids stay removed; they have no edges left to carry over
+    for (int v = 0; v < graph.getNumVertices(); ++v) {
+        if (!graph.hasVertex(v))
+            wider->removeVertex(v);
+    }
+    LOG_INFO("Client %d graph widened from %s to %s", clientId, graph.getTypeName().c_str(),
+             wider->getTypeName().c_str());
+    setGraph(clientId, move(wider));
+}
 
-        while (!pq.empty()) {
-            int u = pq.top().second;
-            int d = pq.top().first;
-            pq.pop();
+void MSTServer::addEdge(int clientId, int u, int v, const WeightValue &weight) {
+    ClientGraph &graph = editableGraph(clientId, GROWTH_PER_EDIT);
+    if (!graph.addEdge(u, v, weight))
+        widenGraph(clientId, graph.getNumVertices(), {{u, v, weight}});
+}
 
-            if (d > dist[u]) continue;
+void MSTServer::removeEdge(int clientId, int u, int v) {
+    editableGraph(clientId).removeEdge(u, v);
+}
 
-            for (const auto &edge : adjList[u]) {
-                int v = edge.first;
-                int weight = edge.second;
-                if (dist[u] + weight < dist[v]) {
-                    dist[v] = dist[u] + weight;
-                    pq.push({dist[v], v});
-                    if (dist[v] > maxDistance) {
-                        maxDistance = dist[v];
-                        furthestNode = v;
-                    }
-                }
-            }
-        }
-        return make_pair(furthestNode, maxDistance);
-    };
+void MSTServer::addVertex(int clientId, int vertex) {
+    if (!editableGraph(clientId, GROWTH_PER_EDIT).addVertex(vertex))
+        widenGraph(clientId, vertex + 1, {});
+}
 
-    // שלב 1: מצא את הקודקוד הרחוק ביותר מנקודה כלשהי (כאן בחרנו קודקוד 0)
-    auto [nodeA, _dummy] = findFurthestNode(0);  // שינוי מזהה מ- _ ל- _dummy
+int MSTServer::addVertex(int clientId) {
+    ClientGraph &graph = editableGraph(clientId, GROWTH_PER_EDIT);
+    int vertex = graph.addVertex();
+    if (vertex >= 0)
+        return vertex;
+    vertex = graph.getNumVertices();
+    widenGraph(clientId, vertex + 1, {});
+    return vertex;
+}
 
-    // שלב 2: בצע DFS שני מהקודקוד שנמצא כדי למצוא את המרחק הרחוק ביותר
-    auto [dummyNode, longestDist] = findFurthestNode(nodeA);  // שינוי מזהה מ- _ ל- dummyNode
+bool MSTServer::removeVertex(int clientId, int vertex) {
+    ClientGraph &graph = editableGraph(clientId);
+    graph.removeVertex(vertex);
+    // amortized: a compaction costs O(V + E) and only follows threshold * V removals
+    if (compactionThreshold <= 0 ||
+        graph.getNumRemovedVertices() < compactionThreshold * graph.getNumVertices())
+        return false;
+    ScopedTimer timer(Metrics::STAGE_COMPACT);
+    int before = graph.getNumVertices();
+    graph.compact();
+    LOG_INFO("Client %d graph compacted from %d to %d vertex ids", clientId, before, graph.getNumVertices());
+    return true;
+}
+
+void MSTServer::updateGraph(int clientId, const vector<pair<int, pair<int, int>>> &changes) {
+    for (const auto &change : changes) {
+        addEdge(clientId, change.second.first, change.second.second, WeightValue(static_cast<long long>(change.first)));
+    }
+}
 
-    // שמור את התוצאה
-    longestDistance[clientId] = longestDist;
+void MSTServer::solveMST(int clientId, const std::string &strategyName) {
+    ScopedTimer timer(Metrics::STAGE_SOLVE_MST);
+    ClientGraph &graph = getGraph(clientId);
+    graph.solveMST(strategyName, *threadPool);
+    shareForest(graph);
 }
 
-// This function calculates the average of the edges from each vertex to each vertex.
-// We used the BFS algorithm to reach from each vertex to each vertex,
-// And also so that we do not repeat the calculation twice (from X to Y and from Y to X).
-void MSTServer::calculateAverageDistance(int clientId) {
-    if (clientMSTResults.find(clientId) == clientMSTResults.end()) {
-        throw runtime_error("MST result not found");
+void MSTServer::shareForest(const ClientGraph &graph) {
+    if (!sharedStore || !graph.isPublished())
+        return;
+    string name;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        for (const auto &named : namedGraphs) {
+            if (named.second.lock().get() == &graph)
+                name = named.first;
+        }
     }
+    if (name.empty())
+        return;
+    try {
+        sharedStore->updateForest(name, graph);
+    }
+    catch (const exception &e) {
+        // the other workers just solve it themselves
+        LOG_WARN("Cannot share the forest of '%s': %s", name.c_str(), e.what());
+    }
+}
+
+vector<int> MSTServer::findPath(int clientId, int source, int target) {
+    return getGraph(clientId).findPath(source, target, *threadPool);
+}
+
+void MSTServer::calculateMeasurements(int clientId) {
+    MSTMeasurements result = getGraph(clientId).measure(*threadPool);
+
+    lock_guard<mutex> lock(stateMutex);
+    measurements[clientId] = result;
+}
 
-    const auto &mst = clientMSTResults[clientId];
-    int V = clientGraphs[clientId]->getNumVertices();
+void MSTServer::visualize(int clientId, bool withMST) const {
+    if (!visualizationEnabled)
+        return;
 
-    // נבנה רשימת שכנות של ה-MST
-    vector<vector<pair<int, int>>> adjList(V);
-    for (const auto &edge : mst) {
-        int u = edge.second.first;
-        int v = edge.second.second;
-        int weight = edge.first;
-        adjList[u].emplace_back(v, weight);
-        adjList[v].emplace_back(u, weight);
+    unique_lock<mutex> lock(stateMutex);
+    auto it = clientGraphs.find(clientId);
+    if (it == clientGraphs.end() || (withMST && !it->second->hasMST())) {
+        throw runtime_error(withMST ? "Client graph or MST result not found" : "Client graph not found");
     }
+    const ClientGraph *graph = it->second.get();
+    lock.unlock();
 
-    // משתנה לשמירת סכום כל המרחקים
-    int totalDistance = 0;
-    int pairCount = 0; // סופר את כל הזוגות שנבדקו
+    graph->visualize(withMST);
+}
 
-    // פונקציה לחישוב המרחקים מכל קודקוד בעזרת BFS
-    auto calculateDistancesFromNode = [&](int start) {
-        vector<int> dist(V, numeric_limits<int>::max());
-        dist[start] = 0;
-        queue<int> q;
-        q.push(start);
+void MSTServer::visualizeGraph(int clientId) const {
+    visualize(clientId, false);
+}
 
-        while (!q.empty()) {
-            int u = q.front();
-            q.pop();
+void MSTServer::visualizeMST(int clientId) const {
+    visualize(clientId, true);
+}
 
-            for (const auto &neighbor : adjList[u]) {
-                int v = neighbor.first;
-                int weight = neighbor.second;
-                if (dist[u] + weight < dist[v]) {
-                    dist[v] = dist[u] + weight;
-                    q.push(v);
-                }
-            }
-        }
-
-        // נוסיף את כל המרחקים מ-start לכל שאר הקודקודים
-        for (int i = 0; i < V; ++i) {
-            if (i != start && dist[i] != numeric_limits<int>::max()) {
-                totalDistance += dist[i];
-                ++pairCount;
-            }
+int MSTServer::submitJob(int clientId, const string &strategyName) {
+    if (strategyName != "kruskal" && strategyName != "prim") {
+        throw runtime_error("Unknown strategy");
+    }
+    auto job = make_shared<MSTJob>();
+    job->clientId = clientId;
+    job->strategyName = strategyName;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        auto it = clientGraphs.find(clientId);
+        if (it == clientGraphs.end()) {
+            throw runtime_error("Client graph not found");
         }
-    };
-
-    // נבצע את החישוב עבור כל קודקוד
-    for (int i = 0; i < V; ++i) {
-        calculateDistancesFromNode(i);
+        vector<int> finished;
+        size_t active = 0;
+        for (const auto &entry : jobs) {
+            if (entry.second->clientId != clientId)
+                continue;
+            int state = entry.second->state;
+            if (state == MSTJob::QUEUED || state == MSTJob::RUNNING)
+                ++active;
+            else
+                finished.push_back(entry.first);
+        }
+        if (active >= MAX_ACTIVE_JOBS) {
+            throw runtime_error("Too many jobs in flight (" + to_string(MAX_ACTIVE_JOBS) + "); wait for one or cancel it");
+        }
+        if (finished.size() > MAX_FINISHED_JOBS) {
+            sort(finished.begin(), finished.end());
+            for (size_t i = 0; i < finished.size() - MAX_FINISHED_JOBS; ++i)
+                jobs.erase(finished[i]);
+        }
+        job->graph = it->second;
+        job->id = nextJobId++;
+        jobs[job->id] = job;
     }
+    LOG_INFO("Client %d submitted job %d (%s)", clientId, job->id, strategyName.c_str());
+    // client id -1 keeps the pool from logging the job as a new session
+    threadPool->enqueue(-1, [this, job](int) { runJob(*job); });
+    return job->id;
+}
 
-    // חישוב הממוצע
-    if (pairCount == 0) {
-        throw runtime_error("No valid pairs found in MST");
+void MSTServer::runJob(MSTJob &job) {
+    try {
+        job.control.checkpoint();
+        job.state = MSTJob::RUNNING;
+        job.result = job.graph->solveAndMeasure(job.strategyName, *threadPool, &job.control);
+        shareForest(*job.graph);
+        job.state = MSTJob::DONE;
     }
+    catch (const JobCancelled &) {
+        job.state = MSTJob::CANCELLED;
+    }
+    catch (const exception &e) {
+        job.error = e.what();
+        job.state = MSTJob::FAILED;
+    }
+    LOG_INFO("Job %d of client %d finished: state %d", job.id, job.clientId, job.state.load());
+    // let edits stop forking, and free the graph if the client has moved on
+    lock_guard<mutex> lock(stateMutex);
+    job.graph.reset();
+}
 
-    averageDistance[clientId] = static_cast<double>(totalDistance) / pairCount;
+shared_ptr<const MSTJob> MSTServer::getJob(int clientId, int jobId) const {
+    lock_guard<mutex> lock(stateMutex);
+    auto it = jobs.find(jobId);
+    if (it == jobs.end() || it->second->clientId != clientId) {
+        throw runtime_error("No job " + to_string(jobId));
+    }
+    return it->second;
 }
 
-void MSTServer::calculateShortestMSTDistance(int clientId) {
-    if (clientMSTResults.find(clientId) == clientMSTResults.end()) {
-        throw runtime_error("MST result not found");
+shared_ptr<const MSTJob> MSTServer::collectJob(int clientId, int jobId) {
+    lock_guard<mutex> lock(stateMutex);
+    auto it = jobs.find(jobId);
+    if (it == jobs.end() || it->second->clientId != clientId) {
+        throw runtime_error("No job " + to_string(jobId));
     }
+    shared_ptr<const MSTJob> job = it->second;
+    if (job->state == MSTJob::DONE)
+        jobs.erase(it);
+    return job;
+}
 
-    const auto &mst = clientMSTResults[clientId];
-    shortestMSTDistance[clientId] = min_element(mst.begin(), mst.end(),
-        [](const auto &a, const auto &b) { return a.first < b.first; })->first;
-}
\ No newline at end of file
+void MSTServer::cancelJob(int clientId, int jobId) {
+    lock_guard<mutex> lock(stateMutex);
+    auto it = jobs.find(jobId);
+    if (it == jobs.end() || it->second->clientId != clientId) {
+        throw runtime_error("No job " + to_string(jobId));
+    }
+    it->second->control.cancel();
+}
@@ -2,41 +2,177 @@
 #define MST_SERVER_HPP
 
 #include "Graph.hpp"
-#include "StrategyFactory.hpp"
+#include "ClientGraph.hpp"
 #include "ThreadPoll.hpp"
+#include "JobControl.hpp"
+#include "SharedGraphStore.hpp"
+#include "EuclideanMST.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <string>
 #include <vector>
 #include <unordered_map>
-#include "GraphVisualizer.hpp"
+#include <mutex>
+
+// One asynchronous solve-and-measure run started with submit
+struct MSTJob
+{
+    enum State { QUEUED, RUNNING, DONE, FAILED, CANCELLED };
+
+    int id = 0;
+    int clientId = 0;
+    string strategyName;
+    // the client's graph when the job was submitted; edits meanwhile go to a private copy
+    shared_ptr<ClientGraph> graph;
+    JobControl control;
+    // result and error are written before state turns DONE or FAILED
+    atomic<int> state{QUEUED};
+    MSTMeasurements result;
+    string error;
+};
+
+// What one client's state costs, for the memory command and the quotas
+struct ClientMemoryUsage
+{
+    // the client's graph as a whole
+    GraphMemoryUsage graph;
+    // sessions holding that graph, the client included; a shared graph is split among them
+    long holders = 0;
+    // cached measurements and job results
+    size_t results = 0;
+
+    size_t charged() const { return (holders > 0 ? graph.total() / holders : 0) + results; }
+};
 
 class MSTServer
 {
 public:
-    unordered_map<int, unique_ptr<Graph>> clientGraphs;
-    unique_ptr<StrategyFactory> strategyFactory;
+    // Each client's graph lives in the narrowest instantiation chosen when it was set,
+    // together with its last MST. Clients attached to the same published graph share it.
+    unordered_map<int, shared_ptr<ClientGraph>> clientGraphs;
+    // Published graphs by name; a name lives as long as some client still holds its graph
+    unordered_map<string, weak_ptr<ClientGraph>> namedGraphs;
     unique_ptr<ThreadPoll> threadPool;
-    unordered_map<int, vector<pair<int, pair<int, int>>>> clientMSTResults;
+
+    // Guards the per-client maps; sessions run concurrently on the thread pool
+    mutable mutex stateMutex;
 
 public:
-    MSTServer(int num_threads);
+    // pin, nodeLocal and firstCpu place the compute pool; see ThreadPoll
+    MSTServer(int num_threads, PinPolicy pin = PinPolicy::NONE, bool nodeLocal = false, size_t firstCpu = 0);
+    // Cancels the jobs still running and waits for the compute pool to drain
+    ~MSTServer();
+    void setGraph(int clientId, unique_ptr<ClientGraph> newGraph);
     void setGraph(int clientId, const Graph &newGraph);
+    // Stores the Euclidean MST of the points as the client's graph, already solved; the
+    // complete distance graph is never built
+    void setPoints(int clientId, vector<EuclideanMST::Point> points);
+    bool hasGraph(int clientId) const;
+    ClientGraph &getGraph(int clientId);
+    void removeClient(int clientId);
+
+    // publish makes the client's graph read-only and visible under name; attach replaces the
+    // client's graph with a published one. Edits to a published graph fork a private copy.
+    void publishGraph(int clientId, const string &name);
+    void attachGraph(int clientId, const string &name);
+    // In worker mode, published graphs also go to the store shared by all worker processes,
+    // and attach falls back to it for names published by another worker
+    void setSharedStore(SharedGraphStore *store);
+    void setVisualization(bool enabled);
+    bool hasVisualization() const;
+    // Duplicate edge policy, and with it the edge index, for graphs set from now on
+    void setDuplicatePolicy(DuplicatePolicy policy);
+    DuplicatePolicy getDuplicatePolicy() const;
+    // Removed vertex ids stay reserved until this fraction of a graph's ids is removed; then
+    // the graph is compacted and renumbered. 0 never compacts.
+    void setCompactionThreshold(double fraction);
+    // Memory quotas in bytes, 0 for none. A client whose charge, or a server whose total,
+    // would pass its quota has new graphs and growing edits refused; reads, solves and
+    // removals on a private graph still work.
+    void setMemoryQuotas(size_t perClient, size_t total);
+    size_t getClientQuota() const;
+    size_t getTotalQuota() const;
+    // Throws if a graph of this size could not fit the quotas, so the caller can refuse it
+    // before reading it in; the estimate is a lower bound
+    void reserveGraph(int clientId, int vertices, size_t edges) const;
+    ClientMemoryUsage getClientMemory(int clientId) const;
+    // Every distinct graph once, plus all cached results
+    size_t getTotalMemory() const;
+
+    // A session brackets each command with these. Idle compaction only touches a graph while
+    // its client runs no command, and beginCommand waits for one that is under way.
+    void beginCommand(int clientId);
+    void endCommand(int clientId);
+    // Trims the spare capacity of private graphs whose client has run no command for idleFor
+    // and has not been trimmed since. Returns the bytes released.
+    size_t compactIdleGraphs(chrono::steady_clock::duration idleFor);
+
+    // Edits; a value that does not fit the graph's instantiation moves it to a wider one
+    void addEdge(int clientId, int u, int v, const WeightValue &weight);
+    void removeEdge(int clientId, int u, int v);
+    void addVertex(int clientId, int vertex);
+    // Reuses a removed id if there is one; returns the new vertex
+    int addVertex(int clientId);
+    // true when the removal triggered a compaction, which renumbers the vertices
+    bool removeVertex(int clientId, int vertex);
     void updateGraph(int clientId, const vector<pair<int, pair<int, int>>> &changes);
+
     void solveMST(int clientId, const string &strategyName);
+    vector<int> findPath(int clientId, int source, int target);
     void calculateMeasurements(int clientId);
     void visualizeGraph(int clientId) const;
     void visualizeMST(int clientId) const;
 
+    // Asynchronous jobs on the compute pool. Job ids are global, but a client only sees its
+    // own jobs; removeClient cancels the ones still running. A client has at most
+    // MAX_ACTIVE_JOBS queued or running; submit drops its oldest finished jobs beyond
+    // MAX_FINISHED_JOBS, and collectJob drops a job whose result it hands out.
+    static const size_t MAX_ACTIVE_JOBS = 4;
+    static const size_t MAX_FINISHED_JOBS = 16;
+    int submitJob(int clientId, const string &strategyName);
+    shared_ptr<const MSTJob> getJob(int clientId, int jobId) const;
+    shared_ptr<const MSTJob> collectJob(int clientId, int jobId);
+    void cancelJob(int clientId, int jobId);
+
     // Measurement results
-    unordered_map<int, int> totalWeight;
-    unordered_map<int, int> longestDistance;
-    unordered_map<int, double> averageDistance;
-    unordered_map<int, int> shortestMSTDistance;
+    unordered_map<int, MSTMeasurements> measurements;
 
 private:
-    void calculateTotalWeight(int clientId);
-    void calculateLongestDistance(int clientId);
-    void calculateAverageDistance(int clientId);
-    void calculateShortestMSTDistance(int clientId);
+    bool visualizationEnabled = true;
+    DuplicatePolicy duplicatePolicy = DuplicatePolicy::ALLOW;
+    double compactionThreshold = 0;
+    unordered_map<int, shared_ptr<MSTJob>> jobs;
+    int nextJobId = 1;
+    SharedGraphStore *sharedStore = nullptr;
+    size_t clientQuota = 0;
+    size_t totalQuota = 0;
+
+    struct ClientActivity
+    {
+        int commands = 0;
+        bool compacting = false;
+        bool trimmed = false;
+        chrono::steady_clock::time_point lastUsed = chrono::steady_clock::now();
+    };
+    unordered_map<int, ClientActivity> activity;
+    condition_variable compactionDone;
+
+    ClientGraph &editableGraph(int clientId, size_t growth = 0);
+    // Both need stateMutex
+    ClientMemoryUsage usageOf(int clientId) const;
+    size_t totalUsage() const;
+    // Throws when the client, charged clientBytes more (or instead of its graph, if
+    // replacing), or the server, with serverBytes more, would pass a quota; needs stateMutex
+    void checkQuota(int clientId, size_t clientBytes, size_t serverBytes, bool replacing) const;
+    // Forgets names whose graph nobody holds any more; needs stateMutex
+    void dropExpiredNames();
+    // Refreshes the shared store's forest of a published graph after a solve
+    void shareForest(const ClientGraph &graph);
+    void runJob(MSTJob &job);
+    void widenGraph(int clientId, int vertices, const vector<ClientGraph::EdgeInput> &extraEdges);
+    void visualize(int clientId, bool withMST) const;
 };
 
-#endif // MST_SERVER_HPP
\ No newline at end of file
+#endif // MST_SERVER_HPP
@@ -0,0 +1,223 @@
+#include "Metrics.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct HistogramInfo {
+    const char *family;   // Prometheus metric family
+    const char *label;    // label name, or nullptr
+    const char *value;    // label value / display name
+};
+
+const HistogramInfo HISTOGRAMS[Metrics::HISTOGRAM_COUNT] = {
+    {"mst_command_duration_seconds", "command", "init"},
+    {"mst_command_duration_seconds", "command", "change_graph"},
+    {"mst_command_duration_seconds", "command", "kruskal"},
+    {"mst_command_duration_seconds", "command", "prim"},
+    {"mst_command_duration_seconds", "command", "other"},
+    {"mst_stage_duration_seconds", "stage", "parse"},
+    {"mst_stage_duration_seconds", "stage", "solve_mst"},
+    {"mst_stage_duration_seconds", "stage", "total_weight"},
+    {"mst_stage_duration_seconds", "stage", "longest_distance"},
+    {"mst_stage_duration_seconds", "stage", "average_distance"},
+    {"mst_stage_duration_seconds", "stage", "shortest_distance"},
+    {"mst_stage_duration_seconds", "stage", "compact"},
+    {"mst_stage_duration_seconds", "stage", "send"},
+    {"mst_threadpool_queue_wait_seconds", nullptr, "queue_wait"},
+};
+
+struct CounterInfo {
+    const char *name;
+    const char *type;
+    const char *help;
+};
+
+const CounterInfo COUNTERS[Metrics::COUNTER_COUNT] = {
+    {"mst_connections_total", "counter", "Accepted client connections"},
+    {"mst_active_connections", "gauge", "Currently connected clients"},
+    {"mst_bytes_received_total", "counter", "Bytes read from client sockets"},
+    {"mst_bytes_sent_total", "counter", "Bytes written to client sockets"},
+    {"mst_threadpool_tasks_total", "counter", "Tasks dequeued by ThreadPoll workers"},
+    {"mst_threadpool_queue_depth", "gauge", "Tasks waiting in the ThreadPoll queue"},
+    {"mst_memory_quota_rejections_total", "counter", "Graphs and edits refused by a memory quota"},
+    {"mst_memory_trimmed_bytes_total", "counter", "Bytes released by idle graph compaction"},
+    {"mst_batch_graphs_total", "counter", "Graphs received by the batch command"},
+};
+
+// Prometheus bucket bounds in seconds; finer LatencyHistogram buckets are folded into these
+const double PROMETHEUS_BOUNDS[] = {1e-6, 1e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2, 0.1, 0.5, 1, 5, 10};
+
+// One shard per thread. Only the owning thread writes, so updates are a relaxed
+// load + store instead of a locked read-modify-write.
+struct MetricsShard {
+    atomic<uint64_t> buckets[Metrics::HISTOGRAM_COUNT][LatencyHistogram::BUCKET_COUNT];
+    atomic<int64_t> counters[Metrics::COUNTER_COUNT];
+
+    MetricsShard() {
+        for (auto &histogram : buckets)
+            for (auto &bucket : histogram)
+                bucket.store(0, memory_order_relaxed);
+        for (auto &counter : counters)
+            counter.store(0, memory_order_relaxed);
+    }
+};
+
+mutex &registryMutex() {
+    static mutex m;
+    return m;
+}
+
+// Shards outlive their threads so counts from finished workers are kept
+vector<unique_ptr<MetricsShard>> &registry() {
+    static vector<unique_ptr<MetricsShard>> shards;
+    return shards;
+}
+
+MetricsShard &localShard() {
+    thread_local MetricsShard *shard = []() {
+        auto created = make_unique<MetricsShard>();
+        MetricsShard *raw = created.get();
+        lock_guard<mutex> lock(registryMutex());
+        registry().push_back(move(created));
+        return raw;
+    }();
+    return *shard;
+}
+
+string labels(const HistogramInfo &info, const string &extra = "") {
+    string out;
+    if (info.label)
+        out = string(info.label) + "=\"" + info.value + "\"";
+    if (!extra.empty())
+        out += (out.empty() ? "" : ",") + extra;
+    return out.empty() ? "" : "{" + out + "}";
+}
+
+} // namespace
+
+void Metrics::record(HistogramId id, uint64_t durationNs) {
+    auto &bucket = localShard().buckets[id][LatencyHistogram::bucketIndex(durationNs)];
+    bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void Metrics::add(CounterId id, int64_t delta) {
+    auto &counter = localShard().counters[id];
+    counter.store(counter.load(memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+Metrics::HistogramId Metrics::commandHistogram(const string &command) {
+    if (command == "init")
+        return COMMAND_INIT;
+    if (command == "change_graph")
+        return COMMAND_CHANGE_GRAPH;
+    if (command == "kruskal")
+        return COMMAND_KRUSKAL;
+    if (command == "prim")
+        return COMMAND_PRIM;
+    return COMMAND_OTHER;
+}
+
+int64_t Metrics::getCounter(CounterId id) {
+    int64_t total = 0;
+    lock_guard<mutex> lock(registryMutex());
+    for (const auto &shard : registry())
+        total += shard->counters[id].load(memory_order_relaxed);
+    return total;
+}
+
+LatencyHistogram Metrics::getHistogram(HistogramId id) {
+    LatencyHistogram histogram;
+    lock_guard<mutex> lock(registryMutex());
+    for (const auto &shard : registry())
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+            histogram.addToBucket(i, shard->buckets[id][i].load(memory_order_relaxed));
+    return histogram;
+}
+
+string Metrics::renderText() {
+    ostringstream oss;
+    oss << "Server statistics:\n";
+    for (int c = 0; c < COUNTER_COUNT; ++c)
+        oss << COUNTERS[c].name << " " << getCounter(static_cast<CounterId>(c)) << "\n";
+
+    oss << left << setw(20) << "latency (ms)" << right << setw(10) << "count" << setw(10) << "p50"
+        << setw(10) << "p99" << setw(10) << "p999" << setw(10) << "max" << "\n";
+    oss << fixed << setprecision(3);
+    for (int h = 0; h < HISTOGRAM_COUNT; ++h) {
+        LatencyHistogram histogram = getHistogram(static_cast<HistogramId>(h));
+        if (histogram.getCount() == 0)
+            continue;
+        oss << left << setw(20) << HISTOGRAMS[h].value << right << setw(10) << histogram.getCount()
+            << setw(10) << histogram.getValueAtPercentile(50) / 1e6
+            << setw(10) << histogram.getValueAtPercentile(99) / 1e6
+            << setw(10) << histogram.getValueAtPercentile(99.9) / 1e6
+            << setw(10) << histogram.getMax() / 1e6 << "\n";
+    }
+    string text = oss.str();
+    text.pop_back();
+    return text;
+}
+
+string Metrics::renderPrometheus() {
+    ostringstream oss;
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        oss << "# HELP " << COUNTERS[c].name << " " << COUNTERS[c].help << "\n"
+            << "# TYPE " << COUNTERS[c].name << " " << COUNTERS[c].type << "\n"
+            << COUNTERS[c].name << " " << getCounter(static_cast<CounterId>(c)) << "\n";
+    }
+
+    const char *lastFamily = "";
+    for (int h = 0; h < HISTOGRAM_COUNT; ++h) {
+        const HistogramInfo &info = HISTOGRAMS[h];
+        if (string(info.family) != lastFamily) {
+            oss << "# TYPE " << info.family << " histogram\n";
+            lastFamily = info.family;
+        }
+
+        LatencyHistogram histogram = getHistogram(static_cast<HistogramId>(h));
+        for (double bound : PROMETHEUS_BOUNDS) {
+            uint64_t cumulative = histogram.getCountAtOrBelow(static_cast<uint64_t>(bound * 1e9));
+            oss << info.family << "_bucket" << labels(info, "le=\"" + to_string(bound) + "\"") << " "
+                << cumulative << "\n";
+        }
+        oss << info.family << "_bucket" << labels(info, "le=\"+Inf\"") << " " << histogram.getCount() << "\n"
+            << info.family << "_sum" << labels(info) << " " << histogram.getMean() * histogram.getCount() / 1e9 << "\n"
+            << info.family << "_count" << labels(info) << " " << histogram.getCount() << "\n";
+    }
+    return oss.str();
+}
+
+bool Metrics::writePrometheus(const string &path) {
+    string temp = path + ".tmp";
+    {
+        ofstream file(temp, ios::trunc);
+        if (!file)
+            return false;
+        file << renderPrometheus();
+        if (!file)
+            return false;
+    }
+    return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+ScopedTimer::ScopedTimer(Metrics::HistogramId id) : id(id), start(chrono::steady_clock::now()) {}
+
+ScopedTimer::~ScopedTimer() {
+    stop();
+}
+
+void ScopedTimer::stop() {
+    if (stopped)
+        return;
+    stopped = true;
+    auto elapsed = chrono::steady_clock::now() - start;
+    Metrics::record(id, chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+}
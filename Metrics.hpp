@@ -0,0 +1,84 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "LatencyHistogram.hpp"
+
+using namespace std;
+
+//This class collects server instrumentation with almost no hot-path cost.
+//Every thread writes into its own shard (plain relaxed stores, no shared cache lines);
+//readers walk all shards and sum them, so the numbers are only aggregated on read.
+class Metrics {
+public:
+    enum HistogramId {
+        COMMAND_INIT,
+        COMMAND_CHANGE_GRAPH,
+        COMMAND_KRUSKAL,
+        COMMAND_PRIM,
+        COMMAND_OTHER,
+        STAGE_PARSE,
+        STAGE_SOLVE_MST,
+        STAGE_TOTAL_WEIGHT,
+        STAGE_LONGEST_DISTANCE,
+        STAGE_AVERAGE_DISTANCE,
+        STAGE_SHORTEST_DISTANCE,
+        STAGE_COMPACT,
+        STAGE_SEND,
+        QUEUE_WAIT,
+        HISTOGRAM_COUNT
+    };
+
+    // Counters only grow; gauges are +1/-1 deltas that may come from different threads
+    enum CounterId {
+        CONNECTIONS_TOTAL,
+        ACTIVE_CONNECTIONS,
+        BYTES_IN,
+        BYTES_OUT,
+        TASKS_TOTAL,
+        QUEUE_DEPTH,
+        QUOTA_REJECTIONS,
+        TRIMMED_BYTES,
+        BATCH_GRAPHS,
+        COUNTER_COUNT
+    };
+
+    static void record(HistogramId id, uint64_t durationNs);
+    static void add(CounterId id, int64_t delta = 1);
+
+    static HistogramId commandHistogram(const string &command);
+
+    // Aggregated views over all threads
+    static int64_t getCounter(CounterId id);
+    static LatencyHistogram getHistogram(HistogramId id);
+
+    // Human-readable summary for the `stats` command
+    static string renderText();
+    // Prometheus text exposition format (version 0.0.4)
+    static string renderPrometheus();
+    // Writes renderPrometheus() to `path` atomically (temp file + rename)
+    static bool writePrometheus(const string &path);
+};
+
+//This class records the lifetime of a scope into a Metrics histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Metrics::HistogramId id);
+    ~ScopedTimer();
+
+    // Records now instead of at scope end, e.g. before a blocking visualization
+    void stop();
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Metrics::HistogramId id;
+    chrono::steady_clock::time_point start;
+    bool stopped = false;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,143 @@
+#include "Placement.hpp"
+#include <algorithm>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+thread_local int pinned_node = -1;
+
+// "0-3,8-11" -> 0 1 2 3 8 9 10 11
+vector<int> parseCpuList(const string &list) {
+    vector<int> cpus;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        if (range.empty() || range == "\n")
+            continue;
+        size_t dash = range.find('-');
+        int first = stoi(range.substr(0, dash));
+        int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+} // namespace
+
+PinPolicy parsePinPolicy(const string &name) {
+    if (name == "none")
+        return PinPolicy::NONE;
+    if (name == "compact")
+        return PinPolicy::COMPACT;
+    if (name == "scatter")
+        return PinPolicy::SCATTER;
+    throw runtime_error("Unknown pinning policy: " + name);
+}
+
+const char *pinPolicyName(PinPolicy policy) {
+    switch (policy) {
+    case PinPolicy::COMPACT:
+        return "compact";
+    case PinPolicy::SCATTER:
+        return "scatter";
+    default:
+        return "none";
+    }
+}
+
+CpuTopology::CpuTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    map<int, vector<int>> byNode;
+    if (DIR *dir = opendir("/sys/devices/system/node")) {
+        while (dirent *entry = readdir(dir)) {
+            string name = entry->d_name;
+            if (name.rfind("node", 0) != 0 || name.size() == 4 || !isdigit(static_cast<unsigned char>(name[4])))
+                continue;
+            ifstream file("/sys/devices/system/node/" + name + "/cpulist");
+            string list;
+            getline(file, list);
+            vector<int> cpus;
+            for (int cpu : parseCpuList(list)) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+            }
+            if (!cpus.empty())
+                byNode[stoi(name.substr(4))] = move(cpus);
+        }
+        closedir(dir);
+    }
+    for (auto &node : byNode)
+        nodes.push_back(move(node.second));
+
+    if (nodes.empty()) {
+        nodes.emplace_back();
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed))
+                nodes[0].push_back(cpu);
+        }
+    }
+}
+
+const CpuTopology &CpuTopology::get() {
+    static const CpuTopology topology;
+    return topology;
+}
+
+size_t CpuTopology::getNumNodes() const {
+    return nodes.size();
+}
+
+const vector<int> &CpuTopology::getCpus(size_t node) const {
+    return nodes[node];
+}
+
+int CpuTopology::pickCpu(PinPolicy policy, size_t index) const {
+    if (policy == PinPolicy::SCATTER) {
+        const vector<int> &cpus = nodes[index % nodes.size()];
+        return cpus[index / nodes.size() % cpus.size()];
+    }
+    size_t total = 0;
+    for (const auto &cpus : nodes)
+        total += cpus.size();
+    index %= total;
+    for (const auto &cpus : nodes) {
+        if (index < cpus.size())
+            return cpus[index];
+        index -= cpus.size();
+    }
+    return nodes[0][0];
+}
+
+int CpuTopology::nodeOf(int cpu) const {
+    for (size_t node = 0; node < nodes.size(); ++node) {
+        if (find(nodes[node].begin(), nodes[node].end(), cpu) != nodes[node].end())
+            return static_cast<int>(node);
+    }
+    return -1;
+}
+
+bool CpuTopology::pinCurrentThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        return false;
+    pinned_node = get().nodeOf(cpu);
+    return true;
+}
+
+int CpuTopology::currentNode() {
+    return pinned_node;
+}
@@ -0,0 +1,51 @@
+#ifndef PLACEMENT_HPP
+#define PLACEMENT_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// How pinned threads are laid out over the CPUs. COMPACT fills one NUMA node before the
+// next; SCATTER deals threads round-robin over the nodes. NONE leaves them to the scheduler.
+enum class PinPolicy
+{
+    NONE,
+    COMPACT,
+    SCATTER
+};
+
+// "none", "compact" or "scatter"; throws on anything else
+PinPolicy parsePinPolicy(const string &name);
+const char *pinPolicyName(PinPolicy policy);
+
+//This class is the machine's NUMA layout, read once from /sys/devices/system/node. Without
+//that directory (or without NUMA) every CPU the process may run on is in node 0.
+//Memory needs no separate placement: Linux puts a page on the node of the thread that first
+//touches it, so a graph built by a pinned thread is local to that thread's node.
+class CpuTopology
+{
+public:
+    static const CpuTopology &get();
+
+    size_t getNumNodes() const;
+    const vector<int> &getCpus(size_t node) const;
+
+    // CPU for the index-th thread of a pinned group
+    int pickCpu(PinPolicy policy, size_t index) const;
+    int nodeOf(int cpu) const;
+
+    // Pins the calling thread to cpu and remembers its node; false if the kernel refused
+    static bool pinCurrentThread(int cpu);
+    // Node the calling thread was pinned to, -1 for a thread that was never pinned
+    static int currentNode();
+
+private:
+    CpuTopology();
+
+    // CPUs of every node with at least one CPU this process may use
+    vector<vector<int>> nodes;
+};
+
+#endif // PLACEMENT_HPP
@@ -0,0 +1,132 @@
+#include "RequestArena.hpp"
+#include <algorithm>
+#include <memory>
+#include <optional>
+
+using namespace std;
+
+namespace {
+
+const size_t INITIAL_CAPACITY = 256 * 1024;
+const size_t MAX_CAPACITY = 64 * 1024 * 1024;
+// A grown buffer is given back once this many requests in a row used at most a quarter of it
+const int SHRINK_AFTER_REQUESTS = 256;
+
+// Sits in front of the monotonic resource and counts the bytes handed out per request
+class UsageCounter : public pmr::memory_resource {
+public:
+    pmr::memory_resource *target = nullptr;
+    size_t usedBytes = 0;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        usedBytes += bytes;
+        return target->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        target->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Forwards to the heap and remembers how much the arena overflowed its buffer
+class OverflowTracker : public pmr::memory_resource {
+public:
+    size_t overflowBytes = 0;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        overflowBytes += bytes;
+        return pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+struct ThreadArena {
+    unique_ptr<byte[]> buffer;
+    size_t capacity = 0;
+    OverflowTracker upstream;
+    optional<pmr::monotonic_buffer_resource> arena;
+    UsageCounter counter;
+    int depth = 0;
+    // requests in a row that stayed under a quarter of the buffer, and the largest of them
+    int smallRequests = 0;
+    size_t smallHighWater = 0;
+
+    ThreadArena() {
+        grow(INITIAL_CAPACITY);
+    }
+
+    void grow(size_t newCapacity) {
+        arena.reset();
+        buffer = make_unique<byte[]>(newCapacity);
+        capacity = newCapacity;
+        arena.emplace(buffer.get(), capacity, &upstream);
+        counter.target = &*arena;
+        smallRequests = 0;
+        smallHighWater = 0;
+    }
+
+    void reset() {
+        size_t used = counter.usedBytes;
+        counter.usedBytes = 0;
+        if (upstream.overflowBytes > 0 && capacity < MAX_CAPACITY) {
+            // the request did not fit: size the buffer for it so the next one stays in place
+            size_t wanted = min(MAX_CAPACITY, capacity + upstream.overflowBytes);
+            upstream.overflowBytes = 0;
+            grow(wanted);
+            return;
+        }
+        upstream.overflowBytes = 0;
+
+        // one huge graph should not pin its buffer on the thread for the rest of the process
+        if (capacity > INITIAL_CAPACITY && used <= capacity / 4) {
+            smallHighWater = max(smallHighWater, used);
+            if (++smallRequests >= SHRINK_AFTER_REQUESTS) {
+                grow(max(INITIAL_CAPACITY, 2 * smallHighWater));
+                return;
+            }
+        }
+        else {
+            smallRequests = 0;
+            smallHighWater = 0;
+        }
+        arena->release();
+    }
+};
+
+ThreadArena &localArena() {
+    thread_local ThreadArena arena;
+    return arena;
+}
+
+} // namespace
+
+pmr::memory_resource *RequestArena::resource() {
+    return &localArena().counter;
+}
+
+RequestArena::Scope::Scope() {
+    ++localArena().depth;
+}
+
+RequestArena::Scope::~Scope() {
+    ThreadArena &arena = localArena();
+    if (--arena.depth == 0)
+        arena.reset();
+}
+
+size_t RequestArena::getCapacity() {
+    return localArena().capacity;
+}
@@ -0,0 +1,204 @@
+#include "Scheduler.hpp"
+#include "Logger.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+thread_local int thread_index = -1;
+
+// One event per wakeup: the session it resumes may run a long command, and the other ready
+// sessions should go to idle threads meanwhile rather than queue behind it
+const int MAX_EVENTS = 1;
+
+} // namespace
+
+void SessionTask::promise_type::unhandled_exception() {
+    try {
+        throw;
+    }
+    catch (const exception &e) {
+        LOG_ERROR("Session ended by an exception: %s", e.what());
+    }
+    catch (...) {
+        LOG_ERROR("Session ended by an unknown exception");
+    }
+}
+
+Scheduler::Scheduler(size_t num_threads, PinPolicy pin, size_t firstCpu) : pin(pin) {
+    const CpuTopology &topology = CpuTopology::get();
+    // one group per node that gets a thread
+    vector<int> groupOfNode(topology.getNumNodes(), -1);
+    for (size_t i = 0; i < num_threads; ++i) {
+        int cpu = pin == PinPolicy::NONE ? -1 : topology.pickCpu(pin, firstCpu + i);
+        size_t node = cpu < 0 ? 0 : topology.nodeOf(cpu);
+        if (groupOfNode[node] < 0) {
+            groupOfNode[node] = static_cast<int>(groups.size());
+            groups.push_back(make_unique<Group>());
+        }
+        cpus.push_back(cpu);
+        threadGroups.push_back(groupOfNode[node]);
+    }
+
+    for (auto &group : groups) {
+        group->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        // a semaphore eventfd: each read takes one posted coroutine
+        group->wake_fd = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+        if (group->epoll_fd < 0 || group->wake_fd < 0) {
+            throw runtime_error("Cannot create the session scheduler");
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = nullptr;
+        epoll_ctl(group->epoll_fd, EPOLL_CTL_ADD, group->wake_fd, &event);
+    }
+
+    for (size_t i = 0; i < num_threads; ++i)
+        threads.emplace_back(&Scheduler::run, this, i);
+}
+
+Scheduler::~Scheduler() {
+    stop = true;
+    // level-triggered and never drained from now on, so every thread wakes up
+    for (auto &group : groups) {
+        armWake(*group, false);
+        uint64_t one = 1;
+        if (write(group->wake_fd, &one, sizeof(one)) < 0)
+            perror("eventfd write");
+    }
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &group : groups) {
+        close(group->wake_fd);
+        close(group->epoll_fd);
+    }
+}
+
+Scheduler::Group &Scheduler::currentGroup() {
+    return *groups[threadGroups[thread_index]];
+}
+
+void Scheduler::post(coroutine_handle<> handle) {
+    postTo(thread_index >= 0 ? currentGroup() : *groups[nextGroup.fetch_add(1) % groups.size()], handle);
+}
+
+void Scheduler::postTo(Group &group, coroutine_handle<> handle) {
+    {
+        lock_guard<mutex> lock(group.queue_mutex);
+        group.runnable.push_back(handle);
+    }
+    uint64_t one = 1;
+    if (write(group.wake_fd, &one, sizeof(one)) < 0)
+        perror("eventfd write");
+}
+
+Scheduler::Offload::Offload(Scheduler &scheduler, ThreadPoll &pool, int clientId, function<void()> work)
+    : scheduler(scheduler), pool(pool), clientId(clientId), work(move(work)) {}
+
+bool Scheduler::Offload::await_ready() {
+    return false;
+}
+
+void Scheduler::Offload::await_suspend(coroutine_handle<> handle) {
+    group = scheduler.threadGroups[thread_index];
+    pool.enqueue(clientId, [this, handle](int) {
+        try {
+            work();
+        }
+        catch (...) {
+            error = current_exception();
+        }
+        scheduler.postTo(*scheduler.groups[group], handle);
+    });
+}
+
+void Scheduler::Offload::await_resume() {
+    if (error)
+        rethrow_exception(error);
+}
+
+Scheduler::Offload Scheduler::offload(ThreadPoll &pool, int clientId, function<void()> work) {
+    return Offload(*this, pool, clientId, move(work));
+}
+
+void Scheduler::add(int fd) {
+    epoll_event event = {};
+    event.events = EPOLLONESHOT;
+    epoll_ctl(currentGroup().epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+void Scheduler::remove(int fd) {
+    epoll_ctl(currentGroup().epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+// The waiter may be resumed on another thread before this returns, so nothing touches it after
+void Scheduler::wait(int fd, uint32_t events, Waiter *waiter) {
+    epoll_event event = {};
+    event.events = events | EPOLLRDHUP | EPOLLONESHOT;
+    event.data.ptr = waiter;
+    epoll_ctl(currentGroup().epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+size_t Scheduler::getNumThreads() const {
+    return threads.size();
+}
+
+int Scheduler::currentThread() {
+    return thread_index;
+}
+
+string Scheduler::describePlacement() const {
+    ostringstream oss;
+    oss << "pinning " << pinPolicyName(pin) << ", " << groups.size() << " epoll group(s)";
+    for (size_t i = 0; i < threads.size(); ++i) {
+        oss << "\n  thread " << i << ": ";
+        if (cpus[i] >= 0)
+            oss << "cpu " << cpus[i] << ", ";
+        oss << "group " << threadGroups[i];
+    }
+    return oss.str();
+}
+
+void Scheduler::armWake(Group &group, bool oneShot) {
+    epoll_event event = {};
+    event.events = oneShot ? EPOLLIN | EPOLLONESHOT : EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(group.epoll_fd, EPOLL_CTL_MOD, group.wake_fd, &event);
+}
+
+void Scheduler::run(size_t index) {
+    thread_index = static_cast<int>(index);
+    if (cpus[index] >= 0 && !CpuTopology::pinCurrentThread(cpus[index]))
+        LOG_WARN("Could not pin scheduler thread %zu to CPU %d", index, cpus[index]);
+    Group &group = currentGroup();
+    epoll_event events[MAX_EVENTS];
+    while (!stop) {
+        int count = epoll_wait(group.epoll_fd, events, MAX_EVENTS, -1);
+        for (int i = 0; i < count && !stop; ++i) {
+            if (events[i].data.ptr) {
+                static_cast<Waiter *>(events[i].data.ptr)->ready();
+                continue;
+            }
+            uint64_t token;
+            bool posted = read(group.wake_fd, &token, sizeof(token)) == sizeof(token);
+            coroutine_handle<> handle;
+            if (posted) {
+                lock_guard<mutex> lock(group.queue_mutex);
+                handle = group.runnable.front();
+                group.runnable.pop_front();
+            }
+            // re-armed before running, so another thread can take the next posted coroutine
+            armWake(group, true);
+            if (handle)
+                handle.resume();
+        }
+    }
+}
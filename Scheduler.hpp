@@ -0,0 +1,121 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Placement.hpp"
+#include "ThreadPoll.hpp"
+
+using namespace std;
+
+//This class runs coroutine sessions on a handful of threads. The threads share one epoll
+//instance; a suspended session is only its coroutine frame and a one-shot registration of
+//its socket, so an idle client costs neither a thread nor a stack. A session's fd is armed
+//for one event at a time, so at most one thread runs a given session.
+//With a pinning policy the threads are pinned and grouped by NUMA node, each group with its
+//own epoll instance. A session stays in the group it was posted to, so the graph it builds
+//is allocated on, and used from, that node.
+class Scheduler {
+public:
+    // Something waiting on a file descriptor; ready() runs on the thread that got the event
+    class Waiter {
+    public:
+        virtual void ready() = 0;
+
+    protected:
+        ~Waiter() = default;
+    };
+
+    // When pinned, thread i takes the CPU the policy gives index firstCpu + i
+    explicit Scheduler(size_t num_threads, PinPolicy pin = PinPolicy::NONE, size_t firstCpu = 0);
+    ~Scheduler();
+
+    // Resumes the coroutine on a scheduler thread: of the caller's group when called from
+    // one, otherwise of the next group in turn
+    void post(coroutine_handle<> handle);
+
+    // Awaited by a session to run blocking work on the compute pool:
+    //     co_await scheduler.offload(pool, clientId, [&] { ... });
+    // The session thread serves other sessions meanwhile, and the session is posted back to
+    // its own group, where its fd is registered, once the work is done. An exception thrown
+    // by the work is rethrown by co_await.
+    class Offload {
+    public:
+        Offload(Scheduler &scheduler, ThreadPoll &pool, int clientId, function<void()> work);
+        bool await_ready();
+        void await_suspend(coroutine_handle<> handle);
+        void await_resume();
+
+    private:
+        Scheduler &scheduler;
+        ThreadPoll &pool;
+        int clientId;
+        function<void()> work;
+        size_t group = 0;
+        exception_ptr error;
+    };
+    Offload offload(ThreadPoll &pool, int clientId, function<void()> work);
+
+    // Called from a session, so in its group. add() registers fd disarmed; wait() arms it
+    // for one EPOLLIN or EPOLLOUT event
+    void add(int fd);
+    void remove(int fd);
+    void wait(int fd, uint32_t events, Waiter *waiter);
+
+    size_t getNumThreads() const;
+    // Index of the calling scheduler thread, -1 on any other thread
+    static int currentThread();
+
+    // Policy, and the CPU and node of every thread
+    string describePlacement() const;
+
+private:
+    // Threads sharing one epoll instance (all of them when unpinned)
+    struct Group {
+        int epoll_fd;
+        // eventfd that wakes a thread to resume posted coroutines
+        int wake_fd;
+        mutex queue_mutex;
+        deque<coroutine_handle<>> runnable;
+    };
+
+    PinPolicy pin;
+    vector<unique_ptr<Group>> groups;
+    vector<thread> threads;
+    // CPU and group of every thread
+    vector<int> cpus;
+    vector<size_t> threadGroups;
+    atomic<size_t> nextGroup{0};
+    atomic<bool> stop{false};
+
+    void run(size_t index);
+    Group &currentGroup();
+    void postTo(Group &group, coroutine_handle<> handle);
+    static void armWake(Group &group, bool oneShot);
+};
+
+// Return type of a session coroutine: it starts suspended, is started with
+// Scheduler::post(task.handle), and frees its frame when it returns
+struct SessionTask {
+    struct promise_type {
+        SessionTask get_return_object() { return {coroutine_handle<promise_type>::from_promise(*this)}; }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        // the frame's locals, and with them the session's cleanup, are already destroyed
+        void unhandled_exception();
+    };
+
+    coroutine_handle<promise_type> handle;
+};
+
+#endif // SCHEDULER_HPP
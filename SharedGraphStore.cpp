@@ -0,0 +1,396 @@
+#include "SharedGraphStore.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t NONE = ~static_cast<size_t>(0);
+const size_t ALIGNMENT = 16;
+
+size_t alignUp(size_t n) {
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// Header of every heap block; nextFree is only meaningful while the block is free
+struct Block
+{
+    size_t size;
+    size_t nextFree;
+};
+
+const size_t BLOCK_HEADER = alignUp(sizeof(Block));
+
+struct Entry
+{
+    char name[SharedGraphStore::MAX_NAME_LENGTH + 1];
+    pid_t owner;
+    // offset of the GraphBlob, 0 for an unused entry
+    size_t offset;
+};
+
+struct SharedEdge
+{
+    int32_t u, v;
+    int32_t floating;
+    int32_t padding;
+    int64_t integral;
+    double real;
+};
+
+// Followed by the graph's edges, the forest edges, then the removed vertex ids
+struct GraphBlob
+{
+    int32_t vertices;
+    int32_t policy;
+    int32_t solved;
+    int32_t padding;
+    uint64_t edges;
+    uint64_t forestEdges;
+    uint64_t removed;
+};
+
+// Bytes of a stored graph, header included
+size_t blobBytes(const GraphBlob &header) {
+    return sizeof(GraphBlob) + (header.edges + header.forestEdges) * sizeof(SharedEdge) +
+           header.removed * sizeof(int32_t);
+}
+
+SharedEdge toShared(const ClientGraph::EdgeInput &edge) {
+    SharedEdge shared = {};
+    shared.u = edge.u;
+    shared.v = edge.v;
+    shared.floating = holds_alternative<double>(edge.weight);
+    if (shared.floating)
+        shared.real = get<double>(edge.weight);
+    else
+        shared.integral = get<long long>(edge.weight);
+    return shared;
+}
+
+ClientGraph::EdgeInput fromShared(const SharedEdge &shared) {
+    ClientGraph::EdgeInput edge;
+    edge.u = shared.u;
+    edge.v = shared.v;
+    if (shared.floating)
+        edge.weight = shared.real;
+    else
+        edge.weight = static_cast<long long>(shared.integral);
+    return edge;
+}
+
+// What a graph is flattened into before the segment is locked
+struct Flattened
+{
+    GraphBlob header = {};
+    vector<SharedEdge> edges;
+    vector<SharedEdge> forest;
+    vector<int32_t> removed;
+
+    size_t bytes() const { return blobBytes(header); }
+};
+
+Flattened flatten(const ClientGraph &graph) {
+    Flattened flat;
+    for (const auto &edge : graph.getEdges())
+        flat.edges.push_back(toShared(edge));
+    flat.header.solved = graph.hasMST();
+    if (flat.header.solved) {
+        for (const auto &edge : graph.getForest())
+            flat.forest.push_back(toShared(edge));
+    }
+    for (int v = 0; v < graph.getNumVertices(); ++v) {
+        if (!graph.hasVertex(v))
+            flat.removed.push_back(v);
+    }
+    flat.header.vertices = graph.getNumVertices();
+    flat.header.policy = static_cast<int32_t>(graph.getDuplicatePolicy());
+    flat.header.edges = flat.edges.size();
+    flat.header.forestEdges = flat.forest.size();
+    flat.header.removed = flat.removed.size();
+    return flat;
+}
+
+} // namespace
+
+struct SharedGraphStore::Segment
+{
+    pthread_mutex_t mutex;
+    size_t heapStart, heapEnd;
+    // free blocks in address order, so neighbours can be merged
+    size_t freeHead;
+    size_t usedBytes;
+    Entry entries[MAX_GRAPHS];
+
+    Block *block(size_t offset) { return reinterpret_cast<Block *>(reinterpret_cast<char *>(this) + offset); }
+    char *at(size_t offset) { return reinterpret_cast<char *>(this) + offset; }
+
+    // First fit; returns the offset of the payload, or NONE
+    size_t allocate(size_t size) {
+        size_t need = BLOCK_HEADER + alignUp(size);
+        size_t *link = &freeHead;
+        while (*link != NONE) {
+            Block *candidate = block(*link);
+            if (candidate->size >= need) {
+                size_t offset = *link;
+                if (candidate->size - need >= BLOCK_HEADER + ALIGNMENT) {
+                    Block *rest = block(offset + need);
+                    rest->size = candidate->size - need;
+                    rest->nextFree = candidate->nextFree;
+                    candidate->size = need;
+                    *link = offset + need;
+                }
+                else {
+                    *link = candidate->nextFree;
+                }
+                usedBytes += candidate->size;
+                return offset + BLOCK_HEADER;
+            }
+            link = &candidate->nextFree;
+        }
+        return NONE;
+    }
+
+    void release(size_t payload) {
+        size_t offset = payload - BLOCK_HEADER;
+        Block *freed = block(offset);
+        usedBytes -= freed->size;
+        size_t previous = NONE;
+        size_t next = freeHead;
+        while (next != NONE && next < offset) {
+            previous = next;
+            next = block(next)->nextFree;
+        }
+        freed->nextFree = next;
+        if (next != NONE && offset + freed->size == next) {
+            freed->size += block(next)->size;
+            freed->nextFree = block(next)->nextFree;
+        }
+        if (previous == NONE) {
+            freeHead = offset;
+        }
+        else if (previous + block(previous)->size == offset) {
+            block(previous)->size += freed->size;
+            block(previous)->nextFree = freed->nextFree;
+        }
+        else {
+            block(previous)->nextFree = offset;
+        }
+    }
+
+    // Rebuilds the heap from the directory alone. A worker that died inside allocate or
+    // release may have left the free list half spliced and a block header half merged, but
+    // the entries and the graphs they point to are complete. Every stored graph keeps a block
+    // just large enough for it, and every gap between them becomes one free block.
+    void recover() {
+        vector<size_t> live;
+        for (Entry &entry : entries) {
+            if (entry.offset)
+                live.push_back(entry.offset - BLOCK_HEADER);
+        }
+        sort(live.begin(), live.end());
+        freeHead = NONE;
+        usedBytes = 0;
+        size_t *link = &freeHead;
+        size_t position = heapStart;
+        for (size_t i = 0; i <= live.size(); ++i) {
+            size_t end = i < live.size() ? live[i] : heapEnd;
+            if (end >= position + BLOCK_HEADER + ALIGNMENT) {
+                Block *gap = block(position);
+                gap->size = end - position;
+                *link = position;
+                link = &gap->nextFree;
+            }
+            else if (end > position && i > 0) {
+                // too small to be a free block, as when allocate did not split it off
+                block(live[i - 1])->size += end - position;
+                usedBytes += end - position;
+            }
+            if (i == live.size())
+                break;
+            Block *used = block(live[i]);
+            used->size = BLOCK_HEADER + alignUp(blobBytes(*reinterpret_cast<GraphBlob *>(at(live[i] + BLOCK_HEADER))));
+            usedBytes += used->size;
+            position = live[i] + used->size;
+        }
+        *link = NONE;
+    }
+
+    // BasicLockable, for lock_guard. A worker that died holding the mutex may have been
+    // anywhere in an update, so the heap is rebuilt before the mutex is marked consistent.
+    void lock() {
+        if (pthread_mutex_lock(&mutex) == EOWNERDEAD) {
+            recover();
+            pthread_mutex_consistent(&mutex);
+        }
+    }
+    void unlock() { pthread_mutex_unlock(&mutex); }
+
+    Entry *find(const string &name) {
+        for (Entry &entry : entries) {
+            if (entry.offset && name == entry.name)
+                return &entry;
+        }
+        return nullptr;
+    }
+};
+
+SharedGraphStore::SharedGraphStore(size_t bytes) : bytes(bytes) {
+    if (bytes < alignUp(sizeof(Segment)) + BLOCK_HEADER + ALIGNMENT) {
+        throw runtime_error("Shared graph store is too small");
+    }
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw runtime_error(string("Cannot map the shared graph store: ") + strerror(errno));
+    }
+    segment = new (memory) Segment();
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&segment->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    segment->heapStart = alignUp(sizeof(Segment));
+    segment->freeHead = segment->heapStart;
+    segment->usedBytes = 0;
+    Block *heap = segment->block(segment->heapStart);
+    heap->size = (bytes - segment->heapStart) & ~(ALIGNMENT - 1);
+    heap->nextFree = NONE;
+    segment->heapEnd = segment->heapStart + heap->size;
+}
+
+SharedGraphStore::~SharedGraphStore() {
+    munmap(segment, bytes);
+}
+
+void SharedGraphStore::publish(const string &name, const ClientGraph &graph) {
+    if (name.size() > MAX_NAME_LENGTH) {
+        throw runtime_error("Graph name is longer than " + to_string(MAX_NAME_LENGTH) + " characters");
+    }
+    store(name, graph, false);
+}
+
+void SharedGraphStore::updateForest(const string &name, const ClientGraph &graph) {
+    store(name, graph, true);
+}
+
+// Published graphs never change, so refreshing the forest rewrites the same graph with it
+void SharedGraphStore::store(const string &name, const ClientGraph &graph, bool replace) {
+    Flattened flat = flatten(graph);
+    lock_guard<Segment> lock(*segment);
+    Entry *entry = segment->find(name);
+    if (replace && !entry)
+        return;
+    if (!replace && entry) {
+        if (entry->owner != getpid())
+            throw runtime_error("Graph name already in use: " + name);
+        replace = true;
+    }
+    if (!entry) {
+        for (Entry &candidate : segment->entries) {
+            if (!candidate.offset) {
+                entry = &candidate;
+                break;
+            }
+        }
+        if (!entry)
+            throw runtime_error("Shared graph store is full (" + to_string(MAX_GRAPHS) + " graphs)");
+    }
+
+    size_t offset = segment->allocate(flat.bytes());
+    if (offset == NONE) {
+        throw runtime_error("Shared graph store is out of memory");
+    }
+    char *out = segment->at(offset);
+    memcpy(out, &flat.header, sizeof(GraphBlob));
+    out += sizeof(GraphBlob);
+    memcpy(out, flat.edges.data(), flat.edges.size() * sizeof(SharedEdge));
+    out += flat.edges.size() * sizeof(SharedEdge);
+    memcpy(out, flat.forest.data(), flat.forest.size() * sizeof(SharedEdge));
+    out += flat.forest.size() * sizeof(SharedEdge);
+    memcpy(out, flat.removed.data(), flat.removed.size() * sizeof(int32_t));
+
+    if (replace) {
+        segment->release(entry->offset);
+    }
+    else {
+        strncpy(entry->name, name.c_str(), MAX_NAME_LENGTH);
+        entry->name[MAX_NAME_LENGTH] = '\0';
+        entry->owner = getpid();
+    }
+    entry->offset = offset;
+}
+
+unique_ptr<ClientGraph> SharedGraphStore::load(const string &name, ThreadPoll &pool) const {
+    GraphBlob header;
+    vector<ClientGraph::EdgeInput> edges, forest;
+    vector<int32_t> removed;
+    {
+        lock_guard<Segment> lock(*segment);
+        Entry *entry = segment->find(name);
+        if (!entry)
+            return nullptr;
+        const char *in = segment->at(entry->offset);
+        memcpy(&header, in, sizeof(GraphBlob));
+        const SharedEdge *shared = reinterpret_cast<const SharedEdge *>(in + sizeof(GraphBlob));
+        edges.reserve(header.edges);
+        for (size_t i = 0; i < header.edges; ++i)
+            edges.push_back(fromShared(shared[i]));
+        shared += header.edges;
+        forest.reserve(header.forestEdges);
+        for (size_t i = 0; i < header.forestEdges; ++i)
+            forest.push_back(fromShared(shared[i]));
+        shared += header.forestEdges;
+        removed.resize(header.removed);
+        memcpy(removed.data(), shared, header.removed * sizeof(int32_t));
+    }
+
+    // the edges are exactly those of the published graph, so no policy can refuse them
+    unique_ptr<ClientGraph> graph =
+        ClientGraph::create(header.vertices, edges, static_cast<DuplicatePolicy>(header.policy));
+    for (int32_t v : removed)
+        graph->removeVertex(v);
+    if (header.solved)
+        graph->restoreForest(forest, pool);
+    return graph;
+}
+
+void SharedGraphStore::unpublish(const string &name) {
+    lock_guard<Segment> lock(*segment);
+    Entry *entry = segment->find(name);
+    if (entry && entry->owner == getpid()) {
+        segment->release(entry->offset);
+        entry->offset = 0;
+    }
+}
+
+void SharedGraphStore::releaseOwner(pid_t owner) {
+    lock_guard<Segment> lock(*segment);
+    for (Entry &entry : segment->entries) {
+        if (entry.offset && entry.owner == owner) {
+            segment->release(entry.offset);
+            entry.offset = 0;
+        }
+    }
+}
+
+size_t SharedGraphStore::getCapacity() const {
+    return bytes - segment->heapStart;
+}
+
+size_t SharedGraphStore::getUsedBytes() const {
+    lock_guard<Segment> lock(*segment);
+    return segment->usedBytes;
+}
@@ -0,0 +1,56 @@
+#ifndef SHARED_GRAPH_STORE_HPP
+#define SHARED_GRAPH_STORE_HPP
+
+#include "ClientGraph.hpp"
+#include "ThreadPoll.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+using namespace std;
+
+//This class keeps published graphs, and the last forest solved on each, in one shared memory
+//segment that every worker process of the server maps at the same place. It is created
+//before the workers are forked; a graph published by one worker can then be attached to by
+//a session on any other. A graph is stored flat (edge array, forest edge array, removed ids)
+//in blocks of a first-fit free-list allocator. The directory and the allocator sit behind a
+//robust process-shared mutex, so a worker that dies holding it does not wedge the others.
+class SharedGraphStore
+{
+public:
+    static const size_t MAX_GRAPHS = 256;
+    static const size_t MAX_NAME_LENGTH = 63;
+
+    explicit SharedGraphStore(size_t bytes);
+    ~SharedGraphStore();
+
+    SharedGraphStore(const SharedGraphStore &) = delete;
+    SharedGraphStore &operator=(const SharedGraphStore &) = delete;
+
+    // Stores graph, with its forest if solved, under name for the calling process.
+    // Throws when another process owns the name or the segment is full.
+    void publish(const string &name, const ClientGraph &graph);
+    // Replaces the stored forest of name with the one graph holds now
+    void updateForest(const string &name, const ClientGraph &graph);
+    // A private copy of the stored graph with its forest restored; nullptr if there is none
+    unique_ptr<ClientGraph> load(const string &name, ThreadPoll &pool) const;
+    // Drops name if the calling process owns it
+    void unpublish(const string &name);
+    // Drops every graph owner published; the supervisor calls it when a worker dies
+    void releaseOwner(pid_t owner);
+
+    size_t getCapacity() const;
+    size_t getUsedBytes() const;
+
+private:
+    struct Segment;
+
+    Segment *segment;
+    size_t bytes;
+
+    // Writes graph under name; replace only overwrites an existing entry
+    void store(const string &name, const ClientGraph &graph, bool replace);
+};
+
+#endif // SHARED_GRAPH_STORE_HPP
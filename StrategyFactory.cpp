@@ -3,48 +3,147 @@
 #include <queue>
 #include <stdexcept>
 #include <limits>
+#include <type_traits>
 #include <vector>
 #include <functional>
+#include <memory_resource>
+#include "RequestArena.hpp"
+#include "EdgeKernels.hpp"
 
 using namespace std;
 
-unique_ptr<MST> ConcreteStrategyFactory::createStrategy(const string &strategyName){
+template <typename Index, typename Weight>
+unique_ptr<BasicMST<Index, Weight>> BasicConcreteStrategyFactory<Index, Weight>::createStrategy(const string &strategyName){
     if (strategyName == "kruskal")
     {
-        return make_unique<KruskalMST>();
+        return make_unique<BasicKruskalMST<Index, Weight>>();
     }
     else if (strategyName == "prim")
     {
-        return make_unique<PrimMST>();
+        return make_unique<BasicPrimMST<Index, Weight>>();
     }
     throw runtime_error("Unknown strategy");
 }
 
+namespace {
+
+// Kruskal's scan takes the sorted edges in blocks this size
+const size_t FILTER_BLOCK = 256;
+
+// Bits that hold every value 0 .. max
+int bitsFor(uint64_t max) {
+    int bits = 0;
+    while (bits < 64 && (max >> bits) != 0)
+        ++bits;
+    return bits;
+}
+
+} // namespace
+
 // Kruskal's algorithm implementation
-vector<pair<int, pair<int, int>>> KruskalMST::computeMST(const Graph &graph){
-    vector<pair<int, pair<int, int>>> result;
-    vector<pair<int, pair<int, int>>> edges = graph.getEdges();
-    sort(edges.begin(), edges.end());
+// Work vectors come from the thread's request arena; only the result is heap allocated.
+// An integral weight (as an offset from the lightest) and both endpoints usually fit one
+// 64-bit key whose order is the order of the (weight, (u, v)) pairs, so the edges are radix
+// sorted as keys; otherwise they are sorted as pairs. The scan then finds the roots of a
+// block of edges at a time and drops the edges inside one tree in a batch.
+template <typename Index, typename Weight>
+typename BasicMST<Index, Weight>::EdgeList BasicKruskalMST<Index, Weight>::computeMST(const BasicGraph<Index, Weight> &graph, JobControl *control){
+    RequestArena::Scope arenaScope;
+    pmr::memory_resource *arena = RequestArena::resource();
 
+    using WeightedEdge = pair<Weight, pair<Index, Index>>;
     int V = graph.getNumVertices();
-    vector<int> parent(V);
-    vector<int> rank(V, 0);
+    typename BasicMST<Index, Weight>::EdgeList result;
+    result.reserve(V > 0 ? V - 1 : 0);
+
+    // Growing inside a monotonic arena leaves every outgrown buffer behind, so size it up front
+    size_t degreeSum = 0;
+    Weight lightest = numeric_limits<Weight>::max(), heaviest = numeric_limits<Weight>::lowest();
+    for (int u = 0; u < V; ++u)
+    {
+        const auto &neighbors = graph.getAdjacentEdges(u);
+        degreeSum += neighbors.size();
+        for (const auto &edge : neighbors)
+        {
+            lightest = min(lightest, edge.second);
+            heaviest = max(heaviest, edge.second);
+        }
+    }
+    int vertexBits = bitsFor(V > 0 ? V - 1 : 0);
+    int weightBits = 64;
+    if constexpr (is_integral_v<Weight>)
+    {
+        if (degreeSum > 0)
+            weightBits = bitsFor(static_cast<uint64_t>(heaviest) - static_cast<uint64_t>(lightest));
+    }
+    bool packed = 2 * vertexBits + weightBits <= 64;
+    const uint64_t vertexMask = (uint64_t(1) << vertexBits) - 1;
+
+    // Narrow instantiations sort narrow edges: 6 bytes each for 16-bit graphs instead of 12
+    pmr::vector<WeightedEdge> edges(arena);
+    pmr::vector<uint64_t> keys(arena);
+    if (packed)
+        keys.reserve(degreeSum / 2);
+    else
+        edges.reserve(degreeSum / 2);
+    for (int u = 0; u < V; ++u)
+    {
+        for (const auto &edge : graph.getAdjacentEdges(u))
+        {
+            if (static_cast<Index>(u) >= edge.first)
+                continue;
+            if (packed)
+                keys.push_back((static_cast<uint64_t>(edge.second) - static_cast<uint64_t>(lightest)) << (2 * vertexBits) |
+                               static_cast<uint64_t>(u) << vertexBits | static_cast<uint64_t>(edge.first));
+            else
+                edges.push_back({edge.second, {static_cast<Index>(u), edge.first}});
+        }
+    }
+    size_t count = packed ? keys.size() : edges.size();
+    auto edgeAt = [&](size_t i) -> WeightedEdge
+    {
+        if (!packed)
+            return edges[i];
+        uint64_t key = keys[i];
+        Weight weight = static_cast<Weight>(static_cast<uint64_t>(lightest) + (key >> (2 * vertexBits)));
+        return {weight, {static_cast<Index>((key >> vertexBits) & vertexMask), static_cast<Index>(key & vertexMask)}};
+    };
+
+    // progress counts the sort as one pass over the edges and the union-find as another
+    if (control)
+        control->addWork(2 * count);
+    jobCheckpoint(control);
+    if (packed)
+    {
+        pmr::vector<uint64_t> scratch(count, arena);
+        EdgeKernels::radixSort(keys.data(), scratch.data(), count);
+    }
+    else
+    {
+        sort(edges.begin(), edges.end());
+    }
+    jobAdvance(control, count);
+    jobCheckpoint(control);
+
+    pmr::vector<int> parent(V, arena);
+    pmr::vector<int> rank(V, 0, arena);
 
     for (int i = 0; i < V; i++)
         parent[i] = i;
 
-    function<int(int)> find = [&parent, &find](int i) -> int
+    // Iterative find with path halving
+    auto find = [&parent](int i)
     {
-        if (parent[i] != i)
-            parent[i] = find(parent[i]);
-        return parent[i];
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
     };
 
-    auto unite = [&parent, &rank, &find](int x, int y)
+    auto unite = [&parent, &rank](int xroot, int yroot)
     {
-        int xroot = find(x);
-        int yroot = find(y);
-
         if (rank[xroot] < rank[yroot])
             parent[xroot] = yroot;
         else if (rank[xroot] > rank[yroot])
@@ -56,66 +155,146 @@ vector<pair<int, pair<int, int>>> KruskalMST::computeMST(const Graph &graph){
         }
     };
 
-    for (const auto &edge : edges)
+    int rootU[FILTER_BLOCK], rootV[FILTER_BLOCK];
+    uint32_t kept[FILTER_BLOCK];
+    size_t scanned = 0;
+    // a spanning tree is complete after V - 1 edges; the heavier rest is never looked at
+    for (size_t begin = 0; begin < count && result.size() + 1 < static_cast<size_t>(V); begin += FILTER_BLOCK)
     {
-        int u = edge.second.first;
-        int v = edge.second.second;
-
-        int set_u = find(u);
-        int set_v = find(v);
+        size_t block = min(FILTER_BLOCK, count - begin);
+        for (size_t i = 0; i < block; ++i)
+        {
+            WeightedEdge edge = edgeAt(begin + i);
+            rootU[i] = find(edge.second.first);
+            rootV[i] = find(edge.second.second);
+        }
+        // a kept edge can still close a cycle through an edge taken earlier in its block
+        size_t candidates = EdgeKernels::keepUnconnected(rootU, rootV, block, kept);
+        for (size_t j = 0; j < candidates; ++j)
+        {
+            WeightedEdge edge = edgeAt(begin + kept[j]);
+            int set_u = find(edge.second.first);
+            int set_v = find(edge.second.second);
+            if (set_u != set_v)
+            {
+                result.push_back(edge);
+                unite(set_u, set_v);
+            }
+        }
 
-        if (set_u != set_v)
+        scanned += block;
+        if (control && scanned % JobControl::CHECK_INTERVAL == 0)
         {
-            result.push_back(edge);
-            unite(set_u, set_v);
+            control->checkpoint();
+            control->advance(JobControl::CHECK_INTERVAL);
         }
     }
+    jobAdvance(control, count - scanned + scanned % JobControl::CHECK_INTERVAL);
 
     return result;
 }
 
 // Prim's algorithm implementation
-vector<pair<int, pair<int, int>>> PrimMST::computeMST(const Graph &graph){
-    vector<pair<int, pair<int, int>>> result;
+// The adjacency is copied into flat target and weight arrays, so a vertex's neighbors are
+// relaxed by one batched kernel call. A visited vertex's key drops to the lowest weight, which
+// no edge improves, so the kernel needs no visited test.
+template <typename Index, typename Weight>
+typename BasicMST<Index, Weight>::EdgeList BasicPrimMST<Index, Weight>::computeMST(const BasicGraph<Index, Weight> &graph, JobControl *control){
+    RequestArena::Scope arenaScope;
+    pmr::memory_resource *arena = RequestArena::resource();
+
+    typename BasicMST<Index, Weight>::EdgeList result;
     int V = graph.getNumVertices();
-    vector<bool> visited(V, false);
-    vector<int> key(V, numeric_limits<int>::max());
-    vector<int> parent(V, -1);
+    if (V == 0)
+        return result;
+    pmr::vector<bool> visited(V, false, arena);
+    pmr::vector<Weight> key(V, numeric_limits<Weight>::max(), arena);
+    pmr::vector<int> parent(V, -1, arena);
 
-    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> pq;
+    pmr::vector<size_t> offsets(V + 1, 0, arena);
+    size_t maxDegree = 0;
+    for (int u = 0; u < V; ++u)
+    {
+        size_t degree = graph.getAdjacentEdges(u).size();
+        offsets[u + 1] = offsets[u] + degree;
+        maxDegree = max(maxDegree, degree);
+    }
+    size_t degreeSum = offsets[V];
+    pmr::vector<int> targets(degreeSum, arena);
+    pmr::vector<Weight> weights(degreeSum, arena);
+    for (int u = 0; u < V; ++u)
+    {
+        size_t i = offsets[u];
+        for (const auto &edge : graph.getAdjacentEdges(u))
+        {
+            targets[i] = static_cast<int>(edge.first);
+            weights[i++] = edge.second;
+        }
+    }
+    pmr::vector<uint32_t> improved(maxDegree, arena);
+
+    // The lazy heap holds at most one entry per edge direction improving a key, plus the start
+    using HeapEntry = pair<Weight, Index>;
+    pmr::vector<HeapEntry> heapStorage(arena);
+    heapStorage.reserve(degreeSum + 1);
+    priority_queue<HeapEntry, pmr::vector<HeapEntry>, greater<HeapEntry>> pq{greater<HeapEntry>(), move(heapStorage)};
 
-    int start = 0;
+    Index start = 0;
     pq.push({0, start});
     key[start] = 0;
 
+    // progress counts visited vertices; only the start vertex's component is reached
+    if (control)
+        control->addWork(V);
+    size_t reached = 0;
     while (!pq.empty())
     {
-        int u = pq.top().second;
+        Index u = pq.top().second;
         pq.pop();
 
         if (visited[u])
             continue;
 
         visited[u] = true;
+        if (control && ++reached % JobControl::CHECK_INTERVAL == 0)
+        {
+            control->checkpoint();
+            control->advance(JobControl::CHECK_INTERVAL);
+        }
 
         if (parent[u] != -1)
         {
-            result.push_back({key[u], {parent[u], u}});
+            result.push_back({key[u], {static_cast<Index>(parent[u]), u}});
         }
+        key[u] = numeric_limits<Weight>::lowest();
 
-        for (const auto &edge : graph.getAdjacentEdges(u))
+        size_t first = offsets[u];
+        size_t candidates = EdgeKernels::relaxCandidates(&targets[first], &weights[first], offsets[u + 1] - first,
+                                                         key.data(), improved.data());
+        for (size_t j = 0; j < candidates; ++j)
         {
-            int v = edge.first;
-            int weight = edge.second;
+            size_t i = first + improved[j];
+            int v = targets[i];
+            Weight weight = weights[i];
 
-            if (!visited[v] && weight < key[v])
+            // a parallel edge earlier in the list may have improved v already
+            if (weight < key[v])
             {
                 parent[v] = u;
                 key[v] = weight;
-                pq.push({key[v], v});
+                pq.push({key[v], static_cast<Index>(v)});
             }
         }
     }
+    // a disconnected graph leaves the unreached vertices counted as done
+    jobAdvance(control, V - reached + reached % JobControl::CHECK_INTERVAL);
 
     return result;
 }
+
+#define INSTANTIATE_STRATEGIES(Index, Weight) \
+    template class BasicConcreteStrategyFactory<Index, Weight>; \
+    template class BasicKruskalMST<Index, Weight>; \
+    template class BasicPrimMST<Index, Weight>;
+FOR_EACH_GRAPH_TYPE(INSTANTIATE_STRATEGIES)
+#undef INSTANTIATE_STRATEGIES
@@ -8,28 +8,48 @@
 
 using namespace std;
 
-//This class directs the construction of the MST according to the user's request
-class StrategyFactory{
+//This class directs the construction of the MST according to the user's request.
+//It is instantiated per graph type, like the strategies it creates.
+template <typename Index, typename Weight>
+class BasicStrategyFactory{
 public:
-    virtual unique_ptr<MST> createStrategy(const string &strategyName) = 0;
-    virtual ~StrategyFactory() = default;
+    virtual unique_ptr<BasicMST<Index, Weight>> createStrategy(const string &strategyName) = 0;
+    virtual ~BasicStrategyFactory() = default;
 };
 
-class ConcreteStrategyFactory : public StrategyFactory{
+template <typename Index, typename Weight>
+class BasicConcreteStrategyFactory : public BasicStrategyFactory<Index, Weight>{
 public:
-    unique_ptr<MST> createStrategy(const string &strategyName) override;
+    unique_ptr<BasicMST<Index, Weight>> createStrategy(const string &strategyName) override;
 };
 
 //This class creates the MST using Kruskal's algorithm
-class KruskalMST : public MST{
+template <typename Index, typename Weight>
+class BasicKruskalMST : public BasicMST<Index, Weight>{
 public:
-    vector<pair<int, pair<int, int>>> computeMST(const Graph &graph) override;
+    using BasicMST<Index, Weight>::computeMST;
+    typename BasicMST<Index, Weight>::EdgeList computeMST(const BasicGraph<Index, Weight> &graph, JobControl *control) override;
 };
 
 //This class creates the MST using Prim's algorithm
-class PrimMST : public MST{
+template <typename Index, typename Weight>
+class BasicPrimMST : public BasicMST<Index, Weight>{
 public:
-    vector<pair<int, pair<int, int>>> computeMST(const Graph &graph) override;
+    using BasicMST<Index, Weight>::computeMST;
+    typename BasicMST<Index, Weight>::EdgeList computeMST(const BasicGraph<Index, Weight> &graph, JobControl *control) override;
 };
 
+using StrategyFactory = BasicStrategyFactory<int, int>;
+using ConcreteStrategyFactory = BasicConcreteStrategyFactory<int, int>;
+using KruskalMST = BasicKruskalMST<int, int>;
+using PrimMST = BasicPrimMST<int, int>;
+
+// Explicitly instantiated in StrategyFactory.cpp for every graph type in Graph.hpp
+#define DECLARE_STRATEGIES(Index, Weight) \
+    extern template class BasicConcreteStrategyFactory<Index, Weight>; \
+    extern template class BasicKruskalMST<Index, Weight>; \
+    extern template class BasicPrimMST<Index, Weight>;
+FOR_EACH_GRAPH_TYPE(DECLARE_STRATEGIES)
+#undef DECLARE_STRATEGIES
+
 #endif // STRATEGY_FACTORY_H
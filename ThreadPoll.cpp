@@ -1,11 +1,27 @@
 #include "ThreadPoll.hpp"
-#include <iostream>
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include <exception>
+#include <memory>
+#include <sstream>
 
 using namespace std;
 
 // Constructor that initializes the thread pool with num_threads
-ThreadPoll::ThreadPoll(size_t num_threads)
-    : stop(false) {
+ThreadPoll::ThreadPoll(size_t num_threads, PinPolicy pin, bool nodeLocal, size_t firstCpu)
+    : pin(pin), nodeLocal(nodeLocal), stop(false) {
+    const CpuTopology &topology = CpuTopology::get();
+    size_t queues = pin == PinPolicy::NONE ? 1 : topology.getNumNodes();
+    tasks.resize(queues);
+    nodeWorkers.assign(queues, 0);
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.push_back(make_unique<Worker>());
+        if (pin != PinPolicy::NONE) {
+            workers[i]->cpu = topology.pickCpu(pin, firstCpu + i);
+            workers[i]->node = topology.nodeOf(workers[i]->cpu);
+        }
+        ++nodeWorkers[workers[i]->node];
+    }
     for (size_t i = 0; i < num_threads; ++i) {
         // Create and launch threads, each identified by its index i
         threads.emplace_back([this, i]() {
@@ -26,11 +42,41 @@ ThreadPoll::~ThreadPoll() {
 
 // Function to add a new task to the task queue
 void ThreadPoll::enqueue(int client_id, function<void(int)> task) {
+    size_t node = queueFor();
     {
         unique_lock<mutex> lock(queue_mutex);
-        tasks.push({ client_id, task });
+        tasks[node].push({ client_id, move(task), chrono::steady_clock::now() });
+    }
+    Metrics::add(Metrics::QUEUE_DEPTH, 1);
+    // with several queues the one woken worker might belong to another node
+    if (tasks.size() == 1)
+        condition.notify_one();
+    else
+        condition.notify_all();
+}
+
+size_t ThreadPoll::queueFor() {
+    int node = CpuTopology::currentNode();
+    if (node >= 0 && static_cast<size_t>(node) < tasks.size() && nodeWorkers[node] > 0)
+        return node;
+    // an unpinned caller, or a node without workers: spread over the nodes that have some
+    for (;;) {
+        size_t candidate = nextQueue.fetch_add(1) % tasks.size();
+        if (nodeWorkers[candidate] > 0)
+            return candidate;
     }
-    condition.notify_one();
+}
+
+bool ThreadPoll::hasWork(size_t node) const {
+    if (!tasks[node].empty())
+        return true;
+    if (nodeLocal)
+        return false;
+    for (const auto &queue : tasks) {
+        if (!queue.empty())
+            return true;
+    }
+    return false;
 }
 
 // Get the thread ID of the current thread
@@ -40,23 +86,107 @@ size_t ThreadPoll::getThreadID() {
 
 // Worker function for each thread
 void ThreadPoll::thread_worker(size_t thread_id) {
+    Worker &self = *workers[thread_id];
+    if (self.cpu >= 0 && !CpuTopology::pinCurrentThread(self.cpu))
+        LOG_WARN("Could not pin pool thread %zu to CPU %d", thread_id, self.cpu);
     while (!stop) {
-        pair<int, function<void(int)>> task;
+        Task task;
         {
             unique_lock<mutex> lock(queue_mutex);
-            condition.wait(lock, [this] { return stop || !tasks.empty(); });
-            if (stop && tasks.empty())
+            condition.wait(lock, [this, &self] { return stop || hasWork(self.node); });
+            if (stop && !hasWork(self.node))
                 return;
 
-            task = tasks.front();
-            tasks.pop();
+            // own node first; otherwise the first other node with work
+            size_t from = self.node;
+            for (size_t i = 0; tasks[from].empty(); ++i)
+                from = (self.node + i + 1) % tasks.size();
+            task = move(tasks[from].front());
+            tasks[from].pop();
+            if (from != self.node)
+                ++self.stolen;
         }
+        ++self.ran;
+        Metrics::add(Metrics::QUEUE_DEPTH, -1);
+        Metrics::add(Metrics::TASKS_TOTAL, 1);
+        auto waited = chrono::steady_clock::now() - task.enqueued;
+        Metrics::record(Metrics::QUEUE_WAIT, chrono::duration_cast<chrono::nanoseconds>(waited).count());
 
-        int client_id = task.first;
-        // Output which thread is serving which client
-        cout << "Thread " << thread_id << " is serving client " << client_id << endl;
+        int client_id = task.client_id;
+        // Output which thread is serving which client (helper tasks have no client)
+        if (client_id >= 0)
+            LOG_INFO("Thread %zu is serving client %d", thread_id, client_id);
 
         // Execute the task and pass thread_id to it
-        task.second(thread_id);
+        task.work(thread_id);
+    }
+}
+
+size_t ThreadPoll::getNumThreads() const {
+    return threads.size();
+}
+
+string ThreadPoll::describePlacement() const {
+    ostringstream oss;
+    oss << "pinning " << pinPolicyName(pin) << ", " << tasks.size() << " task queue(s)"
+        << (nodeLocal ? ", node-local" : "");
+    for (size_t i = 0; i < workers.size(); ++i) {
+        oss << "\n  thread " << i << ": ";
+        if (workers[i]->cpu >= 0)
+            oss << "cpu " << workers[i]->cpu << ", node " << workers[i]->node << ", ";
+        oss << "tasks " << workers[i]->ran << " (" << workers[i]->stolen << " from another node)";
     }
+    return oss.str();
+}
+
+void ThreadPoll::parallelFor(size_t count, const function<void(size_t)> &body) {
+    if (count == 0)
+        return;
+
+    // Shared with the helper tasks, which may only start after the loop has finished
+    struct Loop {
+        const function<void(size_t)> *body;
+        size_t count;
+        atomic<size_t> next{0};
+        size_t finished = 0;
+        exception_ptr error;
+        mutex done_mutex;
+        condition_variable done;
+
+        // Claims and runs items until none are left
+        void drain() {
+            size_t ran = 0;
+            exception_ptr failure;
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                try {
+                    (*body)(i);
+                }
+                catch (...) {
+                    failure = current_exception();
+                }
+                ++ran;
+            }
+            if (ran == 0)
+                return;
+            lock_guard<mutex> lock(done_mutex);
+            if (failure && !error)
+                error = failure;
+            finished += ran;
+            if (finished == count)
+                done.notify_all();
+        }
+    };
+    auto loop = make_shared<Loop>();
+    loop->body = &body;
+    loop->count = count;
+
+    size_t helpers = min(threads.size(), count - 1);
+    for (size_t i = 0; i < helpers; ++i)
+        enqueue(-1, [loop](int) { loop->drain(); });
+    loop->drain();
+
+    unique_lock<mutex> lock(loop->done_mutex);
+    loop->done.wait(lock, [&loop] { return loop->finished == loop->count; });
+    if (loop->error)
+        rethrow_exception(loop->error);
 }
@@ -8,13 +8,21 @@
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "Placement.hpp"
 
 using namespace std;
 
 class ThreadPoll {
 public:
-    // Constructor: Initializes the thread pool with a given number of threads
-    ThreadPoll(size_t num_threads);
+    // Constructor: Initializes the thread pool with a given number of threads.
+    // With a pinning policy every worker is pinned to one CPU and the pool keeps one task
+    // queue per NUMA node: tasks go to the queue of the enqueuing thread's node, and workers
+    // take from their own node first. nodeLocal stops them from taking other nodes' tasks.
+    // Worker i takes the CPU the policy gives index firstCpu + i.
+    ThreadPoll(size_t num_threads, PinPolicy pin = PinPolicy::NONE, bool nodeLocal = false, size_t firstCpu = 0);
 
     // Destructor: Ensures all threads are properly joined and the pool is stopped
     ~ThreadPoll();
@@ -25,12 +33,43 @@ public:
     // Get the thread ID of the current thread (for debugging purposes)
     size_t getThreadID();
 
+    // Runs body(0) .. body(count - 1) on the pool and returns when all have finished.
+    // The calling thread claims items too, so this makes progress (serially at worst)
+    // even when every worker is busy, e.g. when called from inside a pool task.
+    void parallelFor(size_t count, const function<void(size_t)> &body);
+
+    size_t getNumThreads() const;
+
+    // Policy, and per worker its CPU, node and how many tasks it ran from another node
+    string describePlacement() const;
+
 private:
     // Vector of worker threads
     vector<thread> threads;
 
-    // Queue of tasks, each with a client ID and the corresponding task
-    queue<pair<int, function<void(int)>>> tasks;
+    // A queued task with its client ID and the time it was enqueued (for wait-time metrics)
+    struct Task {
+        int client_id;
+        function<void(int)> work;
+        chrono::steady_clock::time_point enqueued;
+    };
+
+    // Where a worker runs and what it has run
+    struct Worker {
+        int cpu = -1;
+        size_t node = 0;
+        atomic<uint64_t> ran{0};
+        atomic<uint64_t> stolen{0};
+    };
+    vector<unique_ptr<Worker>> workers;
+
+    // Tasks waiting for a free worker, one queue per NUMA node (one in all when unpinned)
+    vector<queue<Task>> tasks;
+    // workers per queue; a queue without workers is never enqueued to
+    vector<size_t> nodeWorkers;
+    PinPolicy pin;
+    bool nodeLocal;
+    atomic<size_t> nextQueue{0};
 
     // Mutex for thread-safe access to the task queue
     mutex queue_mutex;
@@ -43,6 +82,10 @@ private:
 
     // Worker function for each thread in the pool
     void thread_worker(size_t thread_id);
+    // Queue for a task enqueued by the calling thread
+    size_t queueFor();
+    // Whether a worker of node has anything to take; needs queue_mutex
+    bool hasWork(size_t node) const;
 };
 
 #endif // THREADPOLL_HPP
@@ -3,19 +3,39 @@
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <vector>
 #include <functional>
 #include <sstream>
+#include <iomanip>
 #include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+#include <cstdlib>
+#include <sys/wait.h>
 #include "Graph.hpp"
+#include "ClientGraph.hpp"
 #include "StrategyFactory.hpp"
 #include "MSTServer.hpp"
 #include "ThreadPoll.hpp"
+#include "Connection.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include "Scheduler.hpp"
+#include "SharedGraphStore.hpp"
+#include "BatchSolver.hpp"
 
 using namespace std;
 
 const int PORT = 9034;
 atomic<bool> server_running(true);
+// Index of this worker process in --workers mode, -1 otherwise
+int worker_index = -1;
 
 string trim(const string &s){
     auto wsfront = find_if_not(s.begin(), s.end(), [](int c)
@@ -26,240 +46,768 @@ string trim(const string &s){
     return (wsback <= wsfront ? string() : string(wsfront, wsback));
 }
 
-void send_response(int client_socket, const string &message){
-    string response = message + "\n> ";
-    send(client_socket, response.c_str(), response.length(), 0);
+// Awaited by the session: co_await send_response(conn, ...)
+Connection::Send send_response(Connection &conn, string message){
+    return conn.sendResponse(move(message));
 }
 
-void show_options(int client_socket){
-    send_response(client_socket, "Available commands: init, change_graph, kruskal, prim, quit, exit");
+Connection::Send show_options(Connection &conn){
+    static const string options = "Available commands: init, init_points, batch <strategy> <count>, change_graph, dump [page], kruskal, prim, submit <strategy>, status <id>, result <id>, cancel <id>, components, path, publish <name>, attach <name>, memory, stats, quit, exit";
+    return conn.sendResponse(options);
 }
 
-string graph_to_string(const Graph& graph) {
+string format_measurements(const MSTMeasurements &result){
     ostringstream oss;
-    oss << "Graph structure:\n";
-    for (int i = 0; i < graph.getNumVertices(); ++i) {
-        oss << "Vertex " << i << " -> ";
-        auto edges = graph.getAdjacentEdges(i);
-        for (const auto& edge : edges) {
-            oss << "(" << edge.first << ", " << edge.second << ") ";
-        }
-        oss << "\n";
-    }
+    oss << "MST Results:\n"
+        << "Total weight: " << weightToString(result.totalWeight) << "\n"
+        << "Longest distance: " << weightToString(result.longestDistance) << "\n"
+        << "Average distance: " << result.averageDistance << "\n"
+        << "Shortest MST distance: " << weightToString(result.shortestMSTDistance);
+    // a disconnected graph gets a spanning forest; `components` lists its trees
+    if (result.components.size() > 1)
+        oss << "\nComponents: " << result.components.size();
     return oss.str();
 }
 
-void handle_client(int client_socket, MSTServer &server, int thread_id){
-    char buffer[1024] = {0};
+// "512 B", "3.4 KiB", "12.0 MiB"
+string format_bytes(size_t bytes){
+    ostringstream oss;
+    oss << fixed << setprecision(1);
+    if (bytes < 1024)
+        oss << bytes << " B";
+    else if (bytes < (1 << 20))
+        oss << bytes / 1024.0 << " KiB";
+    else
+        oss << bytes / 1048576.0 << " MiB";
+    return oss.str();
+}
+
+string format_memory(const MSTServer &server, int clientId){
+    ClientMemoryUsage usage = server.getClientMemory(clientId);
+    string text = "Memory of this session:\n";
+    if (usage.holders > 0){
+        text += "Graph: " + format_bytes(usage.graph.graph) + ", spanning forest: " + format_bytes(usage.graph.forest);
+        if (usage.holders > 1)
+            text += " (shared by " + to_string(usage.holders) + " sessions)";
+        text += "\n";
+    }
+    text += "Results: " + format_bytes(usage.results) + "\n";
+    text += "Charged: " + format_bytes(usage.charged());
+    if (server.getClientQuota())
+        text += " of " + format_bytes(server.getClientQuota());
+    text += "\nServer: " + format_bytes(server.getTotalMemory());
+    if (server.getTotalQuota())
+        text += " of " + format_bytes(server.getTotalQuota());
+    return text;
+}
+
+// "queued", "solving 42%", "done", ... for the status command
+string job_status(const MSTJob &job){
+    switch (job.state.load()){
+    case MSTJob::QUEUED:
+        return "queued";
+    case MSTJob::RUNNING: {
+        const char *phase = job.control.getPhase();
+        string status = phase ? phase : "starting";
+        if (job.control.isCancelled())
+            return status + " (cancelling)";
+        return status + " " + to_string(static_cast<int>(job.control.getProgress() * 100)) + "%";
+    }
+    case MSTJob::DONE:
+        return "done";
+    case MSTJob::FAILED:
+        return "failed: " + job.error;
+    default:
+        return "cancelled";
+    }
+}
+
+// Vertices per page of the dump command
+const int DUMP_PAGE_VERTICES = 1000;
+
+// A batch is read, solved and answered in chunks of at most this many graphs or edges
+const size_t BATCH_CHUNK_GRAPHS = 4096;
+const size_t BATCH_CHUNK_EDGES = 1 << 20;
+
+// Parses "source destination weight"; the weight may be integral or floating-point
+bool parse_edge(const string &line, ClientGraph::EdgeInput &edge) {
+    istringstream iss(line);
+    string weight;
+    if (!(iss >> edge.u >> edge.v >> weight))
+        return false;
+    try {
+        edge.weight = parseWeight(weight);
+    }
+    catch (const exception &) {
+        return false;
+    }
+    return true;
+}
+
+// Parses "vertex"; nothing may follow the id
+bool parse_vertex(const string &line, int &vertex) {
+    istringstream iss(line);
+    return (iss >> vertex) && (iss >> ws).eof();
+}
+
+// Parses "source destination"; nothing may follow the ids
+bool parse_endpoints(const string &line, int &u, int &v) {
+    istringstream iss(line);
+    return (iss >> u >> v) && (iss >> ws).eof();
+}
+
+// Ends a session: drops the client's state before its fd number can be reused, then closes it
+struct SessionGuard {
+    int client_socket;
+    MSTServer &server;
+
+    ~SessionGuard(){
+        Metrics::add(Metrics::ACTIVE_CONNECTIONS, -1);
+        LOG_INFO("Client disconnected, session on fd %d ended", client_socket);
+        server.removeClient(client_socket);
+        close(client_socket);
+    }
+};
+
+// Brackets one command, so idle compaction leaves the client's graph alone meanwhile
+struct CommandGuard {
+    MSTServer &server;
+    int clientId;
+
+    CommandGuard(MSTServer &server, int clientId) : server(server), clientId(clientId){
+        server.beginCommand(clientId);
+    }
+    ~CommandGuard(){
+        server.endCommand(clientId);
+    }
+};
+
+// One client session. It is suspended, without holding a thread, whenever it waits for the
+// client's next line or for socket buffer space, and resumed by any of the scheduler threads.
+SessionTask handle_client(int client_socket, MSTServer &server, Scheduler &scheduler){
+    Metrics::add(Metrics::ACTIVE_CONNECTIONS, 1);
+    SessionGuard guard{client_socket, server};
+    Connection conn(client_socket, scheduler);
+    string line;
     int clientId = client_socket; // Use the socket as a unique client ID
 
     // Notify the client about which thread is serving them
-    string thread_message = "You are being served by thread " + to_string(thread_id) + "\n";
-    send_response(client_socket, thread_message);
+    string thread_message = "You are being served by " +
+                            (worker_index >= 0 ? "worker " + to_string(worker_index) + ", " : string()) +
+                            "thread " + to_string(Scheduler::currentThread()) + "\n";
+    co_await send_response(conn, thread_message);
 
-    show_options(client_socket);
+    co_await show_options(conn);
 
     while (server_running){
-        memset(buffer, 0, 1024);
-        int valread = read(client_socket, buffer, 1024);
-        if (valread <= 0){
-            cout << "Client disconnected" << endl;
+        if (!co_await conn.readLine(line)){
+            LOG_INFO("Client disconnected");
             break;
         }
 
-        string command = trim(string(buffer));
-        cout << "Received command: '" << command << "'" << endl;
+        string command = trim(line);
+        LOG_INFO("Received command: '%s'", command.c_str());
+        ScopedTimer command_timer(Metrics::commandHistogram(command));
+        CommandGuard command_guard(server, clientId);
 
         if (command == "quit" || command == "exit"){
-            cout << "Client requested to quit. Closing connection." << endl;
-            send_response(client_socket, "Goodbye!");
+            LOG_INFO("Client requested to quit. Closing connection.");
+            co_await send_response(conn, "Goodbye!");
             break;
         }
         else if (command == "init"){
-            cout << "Initializing new graph. Waiting for vertices and edges count..." << endl;
-            send_response(client_socket, "Enter number of vertices and edges:");
+            LOG_INFO("Initializing new graph. Waiting for vertices and edges count...");
+            co_await send_response(conn, "Enter number of vertices and edges:");
 
-            memset(buffer, 0, 1024);
-            valread = read(client_socket, buffer, 1024);
-            if (valread <= 0){
-                cout << "Client disconnected" << endl;
+            if (!co_await conn.readLine(line)){
+                LOG_INFO("Client disconnected");
                 break;
             }
 
-            istringstream iss(buffer);
-            int numVertices, numEdges;
-            iss >> numVertices >> numEdges;
+            int numVertices = 0, numEdges = 0;
+            {
+                ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                istringstream iss(line);
+                iss >> numVertices >> numEdges;
+            }
 
             if (numVertices <= 0 || numEdges < 0){
-                send_response(client_socket, "Invalid number of vertices or edges.");
-                show_options(client_socket);
+                co_await send_response(conn, "Invalid number of vertices or edges.");
+                co_await show_options(conn);
+                continue;
+            }
+            // refused before the edges are read, so they are never sent
+            string error;
+            try {
+                server.reserveGraph(clientId, numVertices, numEdges);
+            }
+            catch (const exception &e) {
+                error = string("Error: ") + e.what();
+            }
+            if (!error.empty()){
+                co_await send_response(conn, move(error));
+                co_await show_options(conn);
                 continue;
             }
 
-            Graph current_graph(numVertices);
+            vector<ClientGraph::EdgeInput> edges;
+            edges.reserve(numEdges);
+            string invalid_edge;
 
-            cout << "Waiting for " << numEdges << " edges..." << endl;
-            send_response(client_socket, "Enter edges in format: source destination weight");
+            LOG_INFO("Waiting for %d edges...", numEdges);
+            co_await send_response(conn, "Enter edges in format: source destination weight");
 
             for (int i = 0; i < numEdges; ++i){
-                memset(buffer, 0, 1024);
-                valread = read(client_socket, buffer, 1024);
-                if (valread <= 0){
-                    cout << "Client disconnected" << endl;
-                    return;
+                if (!co_await conn.readLine(line)){
+                    LOG_INFO("Client disconnected");
+                    co_return; // the session guard closes the socket and drops the client state
+                }
+
+                ClientGraph::EdgeInput edge;
+                bool parsed;
+                {
+                    ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                    parsed = parse_edge(line, edge);
+                }
+                // the remaining edge lines are still consumed so the dialog stays in step
+                if (!parsed){
+                    if (invalid_edge.empty())
+                        invalid_edge = trim(line);
+                    continue;
+                }
+                edges.push_back(edge);
+                LOG_DEBUG("Added edge: %d - %d", edge.u, edge.v);
+            }
+
+            if (!invalid_edge.empty()){
+                co_await send_response(conn, "Invalid edge: " + invalid_edge);
+                co_await show_options(conn);
+                continue;
+            }
+            // a session cannot suspend inside a handler, so errors are sent after it
+            try {
+                // the storage type is chosen here, once, from the vertex count and weights
+                server.setGraph(clientId, ClientGraph::create(numVertices, edges, server.getDuplicatePolicy()));
+            }
+            catch (const exception &e) {
+                error = string("Error: ") + e.what();
+            }
+            if (!error.empty()){
+                co_await send_response(conn, move(error));
+                co_await show_options(conn);
+                continue;
+            }
+            co_await send_response(conn, "Graph initialized successfully. Visualizing graph...");
+            // the SFML window blocks until closed; it is not part of the command latency
+            command_timer.stop();
+            if (server.hasVisualization())
+                co_await scheduler.offload(*server.threadPool, clientId, [&] { server.visualizeGraph(clientId); });
+            co_await show_options(conn);
+        }
+
+        else if (command == "init_points"){
+            LOG_INFO("Initializing a point set. Waiting for point count and dimension...");
+            co_await send_response(conn, "Enter number of points and dimension (2 or 3):");
+
+            if (!co_await conn.readLine(line)){
+                LOG_INFO("Client disconnected");
+                break;
+            }
+
+            int numPoints = 0, dimension = 0;
+            {
+                ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                istringstream iss(line);
+                iss >> numPoints >> dimension;
+            }
+
+            if (numPoints <= 0 || (dimension != 2 && dimension != 3)){
+                co_await send_response(conn, "Invalid number of points or dimension.");
+                co_await show_options(conn);
+                continue;
+            }
+            string error;
+            try {
+                // the points become a tree of numPoints - 1 edges
+                server.reserveGraph(clientId, numPoints, numPoints - 1);
+            }
+            catch (const exception &e) {
+                error = string("Error: ") + e.what();
+            }
+            if (!error.empty()){
+                co_await send_response(conn, move(error));
+                co_await show_options(conn);
+                continue;
+            }
+
+            vector<EuclideanMST::Point> points;
+            points.reserve(numPoints);
+            string invalid_point;
+
+            LOG_INFO("Waiting for %d points...", numPoints);
+            co_await send_response(conn, dimension == 2 ? "Enter points in format: x y" : "Enter points in format: x y z");
+
+            for (int i = 0; i < numPoints; ++i){
+                if (!co_await conn.readLine(line)){
+                    LOG_INFO("Client disconnected");
+                    co_return;
+                }
+
+                EuclideanMST::Point point = {0, 0, 0};
+                bool parsed;
+                {
+                    ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                    istringstream point_iss(line);
+                    parsed = static_cast<bool>(point_iss >> point[0] >> point[1]) &&
+                             (dimension == 2 || static_cast<bool>(point_iss >> point[2])) &&
+                             all_of(point.begin(), point.end(), [](double coordinate){
+                                 return fabs(coordinate) <= EuclideanMST::MAX_COORDINATE;
+                             });
                 }
+                // like init, the remaining lines are still consumed
+                if (!parsed){
+                    if (invalid_point.empty())
+                        invalid_point = trim(line);
+                    continue;
+                }
+                points.push_back(point);
+            }
+
+            if (!invalid_point.empty()){
+                co_await send_response(conn, "Invalid point: " + invalid_point);
+                co_await show_options(conn);
+                continue;
+            }
+
+            string reply;
+            bool solved = false;
+            try {
+                co_await scheduler.offload(*server.threadPool, clientId, [&] {
+                    server.setPoints(clientId, move(points));
+                    server.calculateMeasurements(clientId);
+                });
+
+                lock_guard<mutex> lock(server.stateMutex);
+                reply = "Euclidean MST of " + to_string(numPoints) + " points computed. " +
+                        format_measurements(server.measurements[clientId]);
+                solved = true;
+            }
+            catch (const exception &e) {
+                reply = string("Error: ") + e.what();
+            }
+            co_await send_response(conn, move(reply));
 
-                istringstream edge_iss(buffer);
-                int u, v, weight;
-                edge_iss >> u >> v >> weight;
-                current_graph.addEdge(u, v, weight);
-                cout << "Added edge: " << u << " - " << v << " (weight: " << weight << ")" << endl;
+            command_timer.stop();
+            if (solved && server.hasVisualization())
+                co_await scheduler.offload(*server.threadPool, clientId, [&] { server.visualizeMST(clientId); });
+            co_await show_options(conn);
+        }
+
+        else if (command.rfind("batch ", 0) == 0){
+            istringstream batch_iss(command.substr(6));
+            string strategy_name;
+            long long count = 0;
+            batch_iss >> strategy_name >> count;
+            BatchSolver::Strategy strategy = BatchSolver::Strategy::KRUSKAL;
+            string error;
+            try {
+                strategy = BatchSolver::parseStrategy(strategy_name);
             }
+            catch (const exception &e) {
+                error = string("Error: ") + e.what();
+            }
+            if (error.empty() && count <= 0)
+                error = "Invalid number of graphs.";
+            if (!error.empty()){
+                co_await send_response(conn, move(error));
+                co_await show_options(conn);
+                continue;
+            }
+
+            LOG_INFO("Waiting for a batch of %lld graphs...", count);
+            co_await send_response(conn, "Enter " + to_string(count) + " graphs, one per line: vertices edges u v w u v w ...\n"
+                                         "Results stream back per chunk, one line per graph: index total longest average shortest components");
 
-            server.setGraph(clientId, current_graph);
-            send_response(client_socket, "Graph initialized successfully. Visualizing graph...");
-            server.visualizeGraph(clientId);
-            show_options(client_socket);
+            // results are sent while later graphs are still coming in, so the client has to
+            // read them as it writes
+            BatchSolver batch;
+            long long done = 0;
+            size_t failed = 0;
+            while (done < count){
+                batch.clear();
+                while (done + static_cast<long long>(batch.size()) < count && batch.size() < BATCH_CHUNK_GRAPHS &&
+                       batch.edgeCount() < BATCH_CHUNK_EDGES){
+                    if (!co_await conn.readLine(line)){
+                        LOG_INFO("Client disconnected");
+                        co_return;
+                    }
+                    ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                    batch.addGraph(line);
+                }
+                co_await scheduler.offload(*server.threadPool, clientId, [&] {
+                    ScopedTimer solve_timer(Metrics::STAGE_SOLVE_MST);
+                    batch.solve(*server.threadPool, strategy);
+                });
+                string results;
+                batch.appendResults(results, done);
+                co_await conn.sendAll(move(results));
+                failed += batch.failedCount();
+                done += batch.size();
+            }
+            co_await send_response(conn, "Batch solved: " + to_string(count) + " graphs, " + to_string(failed) + " failed");
+            co_await show_options(conn);
         }
 
         else if (command == "change_graph"){
-            cout << "Updating graph" << endl;
-            if(!server.clientGraphs.count(clientId)){
-                send_response(client_socket, "Please initialize a graph first using 'init' command.");
-                show_options(client_socket);
+            LOG_INFO("Updating graph");
+            if(!server.hasGraph(clientId)){
+                co_await send_response(conn, "Please initialize a graph first using 'init' command.");
+                co_await show_options(conn);
                 continue;
             }
-            send_response(client_socket, "Enter what you want to do: add_edge, remove_edge, add_vertex, remove_vertex");
+            co_await send_response(conn, "Enter what you want to do: add_edge, remove_edge, add_vertex, remove_vertex");
             
-            memset(buffer, 0, 1024);
-            valread = read(client_socket, buffer, 1024);
-            if (valread <= 0){
-                cout << "Client disconnected" << endl;
+            if (!co_await conn.readLine(line)){
+                LOG_INFO("Client disconnected");
                 break;
             }
             
-            string subcommand = trim(string(buffer));
-            Graph& client_graph = *(server.clientGraphs[clientId]);
+            string subcommand = trim(line);
+            string reply;
             
+            try {
             if(subcommand == "add_edge"){
-                send_response(client_socket, "Enter the edge in format: source destination weight");
-                memset(buffer, 0, 1024);
-                valread = read(client_socket, buffer, 1024);
-                if (valread <= 0){
-                    cout << "Client disconnected" << endl;
+                co_await send_response(conn, "Enter the edge in format: source destination weight");
+                if (!co_await conn.readLine(line)){
+                    LOG_INFO("Client disconnected");
                     break;
                 }
 
-                istringstream edge_iss(buffer);
-                int u, v, weight;
-                edge_iss >> u >> v >> weight;
-                client_graph.addEdge(u, v, weight);
-                send_response(client_socket, "Edge added successfully. Updated graph:\n" + graph_to_string(client_graph));
+                ClientGraph::EdgeInput edge;
+                bool parsed;
+                {
+                    ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                    parsed = parse_edge(line, edge);
+                }
+                if (!parsed)
+                    throw runtime_error("Invalid edge: " + trim(line));
+                server.addEdge(clientId, edge.u, edge.v, edge.weight);
+                reply = "Edge added: " + to_string(edge.u) + " " + to_string(edge.v) + " " + weightToString(edge.weight);
             }
             else if(subcommand == "remove_edge"){
-                send_response(client_socket, "Enter the edge in format: source destination");
-                memset(buffer, 0, 1024);
-                valread = read(client_socket, buffer, 1024);
-                if (valread <= 0){
-                    cout << "Client disconnected" << endl;
+                co_await send_response(conn, "Enter the edge in format: source destination");
+                if (!co_await conn.readLine(line)){
+                    LOG_INFO("Client disconnected");
                     break;
                 }
 
-                istringstream edge_iss(buffer);
                 int u, v;
-                edge_iss >> u >> v;
-                client_graph.removeEdge(u, v);
-                send_response(client_socket, "Edge removed successfully. Updated graph:\n" + graph_to_string(client_graph));
+                bool parsed;
+                {
+                    ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                    parsed = parse_endpoints(line, u, v);
+                }
+                if (!parsed)
+                    throw runtime_error("Invalid edge: " + trim(line));
+                server.removeEdge(clientId, u, v);
+                reply = "Edge removed: " + to_string(u) + " " + to_string(v);
             }
             else if(subcommand == "add_vertex"){
-                send_response(client_socket, "Enter the vertex to add");
-                memset(buffer, 0, 1024);
-                valread = read(client_socket, buffer, 1024);
-                if (valread <= 0){
-                    cout << "Client disconnected" << endl;
+                co_await send_response(conn, "Enter the vertex to add, or 'new' to reuse a removed id");
+                if (!co_await conn.readLine(line)){
+                    LOG_INFO("Client disconnected");
                     break;
                 }
 
-                istringstream vertex_iss(buffer);
                 int vertex;
-                vertex_iss >> vertex;
-                client_graph.addVertex(vertex);
-                send_response(client_socket, "Vertex added successfully. Updated graph:\n" + graph_to_string(client_graph));
+                if (trim(line) == "new") {
+                    vertex = server.addVertex(clientId);
+                }
+                else {
+                    bool parsed;
+                    {
+                        ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                        parsed = parse_vertex(line, vertex);
+                    }
+                    if (!parsed)
+                        throw runtime_error("Invalid vertex: " + trim(line));
+                    server.addVertex(clientId, vertex);
+                }
+                reply = "Vertex added: " + to_string(vertex);
             }
             else if(subcommand == "remove_vertex"){
-                send_response(client_socket, "Enter the vertex to remove");
-                memset(buffer, 0, 1024);
-                valread = read(client_socket, buffer, 1024);
-                if (valread <= 0){
-                    cout << "Client disconnected" << endl;
+                co_await send_response(conn, "Enter the vertex to remove");
+                if (!co_await conn.readLine(line)){
+                    LOG_INFO("Client disconnected");
                     break;
                 }
 
-                istringstream vertex_iss(buffer);
                 int vertex;
-                vertex_iss >> vertex;
-                client_graph.removeVertex(vertex);
-                send_response(client_socket, "Vertex removed successfully. Updated graph:\n" + graph_to_string(client_graph));
+                bool parsed;
+                {
+                    ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                    parsed = parse_vertex(line, vertex);
+                }
+                if (!parsed)
+                    throw runtime_error("Invalid vertex: " + trim(line));
+                bool compacted = server.removeVertex(clientId, vertex);
+                reply = "Vertex removed: " + to_string(vertex) +
+                        (compacted ? " (vertex ids were compacted; see dump)" : "");
             }
             else{
-                send_response(client_socket, "Invalid subcommand for change_graph.");
+                reply = "Invalid subcommand for change_graph.";
             }
-            show_options(client_socket);
+            }
+            catch (const exception &e) {
+                reply = string("Error: ") + e.what();
+            }
+            co_await send_response(conn, move(reply));
+            co_await show_options(conn);
         }       
 
         else if (command == "kruskal" || command == "prim"){
-            if (!server.clientGraphs.count(clientId)){
-                send_response(client_socket, "Please initialize a graph first using 'init' command.");
-                show_options(client_socket);
+            if (!server.hasGraph(clientId)){
+                co_await send_response(conn, "Please initialize a graph first using 'init' command.");
+                co_await show_options(conn);
                 continue;
             }
 
-            cout << "Received " << command << " command. Processing..." << endl;
-
-            server.solveMST(clientId, command);
-            server.calculateMeasurements(clientId);
+            LOG_INFO("Received %s command. Processing...", command.c_str());
 
             ostringstream oss;
-            oss << "MST Results:\n"
-                << "Total weight: " << server.totalWeight[clientId] << "\n"
-                << "Longest distance: " << server.longestDistance[clientId] << "\n"
-                << "Average distance: " << server.averageDistance[clientId] << "\n"
-                << "Shortest MST distance: " << server.shortestMSTDistance[clientId];
+            string error;
+            try {
+                co_await scheduler.offload(*server.threadPool, clientId, [&] {
+                    server.solveMST(clientId, command);
+                    server.calculateMeasurements(clientId);
+                });
+
+                lock_guard<mutex> lock(server.stateMutex);
+                oss << format_measurements(server.measurements[clientId]);
+            }
+            catch (const exception &e) {
+                error = string("Error: ") + e.what();
+            }
+            if (!error.empty()){
+                co_await send_response(conn, move(error));
+                co_await show_options(conn);
+                continue;
+            }
+
+            co_await send_response(conn, oss.str());
+            LOG_INFO("Sent MST results to client");
+
+            command_timer.stop();
+            if (server.hasVisualization())
+                co_await scheduler.offload(*server.threadPool, clientId, [&] { server.visualizeMST(clientId); });
+            co_await show_options(conn);
+        }
+        else if (command == "path"){
+            if (!server.hasGraph(clientId)){
+                co_await send_response(conn, "Please initialize a graph first using 'init' command.");
+                co_await show_options(conn);
+                continue;
+            }
+            co_await send_response(conn, "Enter source and destination vertices:");
+            if (!co_await conn.readLine(line)){
+                LOG_INFO("Client disconnected");
+                break;
+            }
 
-            send_response(client_socket, oss.str());
-            cout << "Sent MST results to client" << endl;
+            int source = -1, destination = -1;
+            {
+                ScopedTimer parse_timer(Metrics::STAGE_PARSE);
+                istringstream path_iss(line);
+                path_iss >> source >> destination;
+            }
+            string reply;
+            try {
+                vector<int> path = server.findPath(clientId, source, destination);
+                if (path.empty()){
+                    reply = "No path between " + to_string(source) + " and " + to_string(destination);
+                }
+                else{
+                    ostringstream oss;
+                    oss << "Path (" << path.size() - 1 << " edges): ";
+                    for (size_t i = 0; i < path.size(); ++i)
+                        oss << (i ? " -> " : "") << path[i];
+                    reply = oss.str();
+                }
+            }
+            catch (const exception &e) {
+                reply = string("Error: ") + e.what();
+            }
+            co_await send_response(conn, move(reply));
+            co_await show_options(conn);
+        }
+        else if (command == "components"){
+            ostringstream oss;
+            {
+                lock_guard<mutex> lock(server.stateMutex);
+                auto it = server.measurements.find(clientId);
+                if (it == server.measurements.end()){
+                    oss << "Run kruskal or prim first.";
+                }
+                else{
+                    const auto &components = it->second.components;
+                    oss << "Spanning forest components: " << components.size();
+                    for (size_t c = 0; c < components.size(); ++c){
+                        const ComponentMeasurements &component = components[c];
+                        oss << "\nComponent " << c << ": vertices " << component.vertices
+                            << ", edges " << component.edges
+                            << ", total weight " << weightToString(component.totalWeight)
+                            << ", longest " << weightToString(component.longestDistance)
+                            << ", average " << component.averageDistance
+                            << ", shortest " << weightToString(component.shortestMSTDistance);
+                    }
+                }
+            }
+            co_await send_response(conn, oss.str());
+            co_await show_options(conn);
+        }
+        else if (command == "dump" || command.rfind("dump ", 0) == 0){
+            if (!server.hasGraph(clientId)){
+                co_await send_response(conn, "Please initialize a graph first using 'init' command.");
+                co_await show_options(conn);
+                continue;
+            }
+            int page = 0;
+            istringstream page_iss(command.substr(4));
+            if (command.size() > 4 && !(page_iss >> page))
+                page = -1;
 
-            server.visualizeMST(clientId);
-            show_options(client_socket);
+            const ClientGraph &graph = server.getGraph(clientId);
+            int pages = max(1, (graph.getNumVertices() + DUMP_PAGE_VERTICES - 1) / DUMP_PAGE_VERTICES);
+            if (page < 0 || page >= pages){
+                co_await send_response(conn, "Invalid page. Pages: 0 .. " + to_string(pages - 1));
+            }
+            else{
+                int first = page * DUMP_PAGE_VERTICES;
+                int last = min(graph.getNumVertices(), first + DUMP_PAGE_VERTICES);
+                // assembled in the connection's buffer, which is reused for the next dump
+                string &out = conn.responseBuffer();
+                out += "Graph structure, page " + to_string(page) + " of " + to_string(pages) +
+                       " (vertices " + to_string(first) + " .. " + to_string(last - 1) + "):\n";
+                graph.appendAdjacency(out, first, last);
+                co_await conn.sendResponse(out);
+                conn.releaseResponseBuffer();
+            }
+            co_await show_options(conn);
+        }
+        else if (command.rfind("submit ", 0) == 0){
+            string reply;
+            try {
+                int job_id = server.submitJob(clientId, trim(command.substr(7)));
+                reply = "Job " + to_string(job_id) + " submitted";
+            }
+            catch (const exception &e) {
+                reply = string("Error: ") + e.what();
+            }
+            co_await send_response(conn, move(reply));
+            co_await show_options(conn);
+        }
+        else if (command.rfind("status ", 0) == 0 || command.rfind("result ", 0) == 0 ||
+                 command.rfind("cancel ", 0) == 0){
+            string verb = command.substr(0, 6);
+            string reply;
+            try {
+                int job_id = stoi(command.substr(7));
+                if (verb == "cancel"){
+                    server.cancelJob(clientId, job_id);
+                    reply = "Cancelling job " + to_string(job_id);
+                }
+                else{
+                    // a result is handed out once; the job is dropped with it
+                    shared_ptr<const MSTJob> job = verb == "status" ? server.getJob(clientId, job_id)
+                                                                    : server.collectJob(clientId, job_id);
+                    if (verb == "status" || job->state != MSTJob::DONE)
+                        reply = "Job " + to_string(job_id) + " (" + job->strategyName + "): " + job_status(*job);
+                    else
+                        reply = format_measurements(job->result);
+                }
+            }
+            catch (const logic_error &) {
+                reply = "Invalid job id: " + trim(command.substr(7));
+            }
+            catch (const exception &e) {
+                reply = string("Error: ") + e.what();
+            }
+            co_await send_response(conn, move(reply));
+            co_await show_options(conn);
+        }
+        else if (command.rfind("publish ", 0) == 0 || command.rfind("attach ", 0) == 0){
+            bool publish = command[0] == 'p';
+            string name = trim(command.substr(command.find(' ')));
+            string reply;
+            try {
+                if (name.empty())
+                    throw runtime_error("Missing graph name");
+                if (publish){
+                    server.publishGraph(clientId, name);
+                    reply = "Graph published as '" + name + "'. It is now read-only; edits work on a private copy.";
+                }
+                else{
+                    server.attachGraph(clientId, name);
+                    const ClientGraph &graph = server.getGraph(clientId);
+                    reply = "Attached to graph '" + name + "' (" + to_string(graph.getNumVertices()) +
+                            " vertices, " + graph.getTypeName() + ")";
+                }
+            }
+            catch (const exception &e) {
+                reply = string("Error: ") + e.what();
+            }
+            co_await send_response(conn, move(reply));
+            co_await show_options(conn);
+        }
+        else if (command == "memory"){
+            co_await send_response(conn, format_memory(server, clientId));
+            co_await show_options(conn);
+        }
+        else if (command == "stats"){
+            co_await send_response(conn, Metrics::renderText() +
+                                             "\nSession threads: " + scheduler.describePlacement() +
+                                             "\nCompute pool: " + server.threadPool->describePlacement());
+            co_await show_options(conn);
+        }
+        else if (command == "stats prometheus"){
+            co_await send_response(conn, Metrics::renderPrometheus());
+            co_await show_options(conn);
         }
         else{
-            send_response(client_socket, "Invalid command.");
-            show_options(client_socket);
+            co_await send_response(conn, "Invalid command.");
+            co_await show_options(conn);
         }
     }
-
-    close(client_socket);
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <number_of_threads>" << endl;
-        return 1;
-    }
+// Command line settings of one server process
+struct ServerOptions {
+    int num_threads = 1;
+    bool headless = false;
+    string metrics_file;
+    DuplicatePolicy duplicate_policy = DuplicatePolicy::ALLOW;
+    double compact_threshold = 0;
+    PinPolicy pin = PinPolicy::NONE;
+    bool node_local = false;
+    size_t client_memory_mb = 0;
+    size_t total_memory_mb = 0;
+    int idle_compact_seconds = 60;
+};
 
-    int num_threads = stoi(argv[1]);
-    cout << "Number of threads: " << num_threads << endl;
-    int server_fd, new_socket;
+// A listening socket of its own; with SO_REUSEPORT every worker binds one to the same port
+// and the kernel spreads new connections across them
+int open_listener(){
+    int server_fd;
     struct sockaddr_in address;
     int opt = 1;
-    int addrlen = sizeof(address);
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         perror("socket failed");
         exit(EXIT_FAILURE);
     }
 
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt))) {
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
         perror("setsockopt");
         exit(EXIT_FAILURE);
     }
@@ -273,15 +821,64 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    if (listen(server_fd, 1) < 0) { // Set to listen to only one connection at a time
+    // a backlog of 1 makes the kernel drop SYNs as soon as a few clients connect at once
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen");
         exit(EXIT_FAILURE);
     }
+    return server_fd;
+}
+
+// The whole server in one process: sessions, compute pool and accept loop
+void serve(int server_fd, const ServerOptions &options, SharedGraphStore *store){
+    LOG_INFO("Number of threads: %d", options.num_threads);
+    int new_socket;
+    struct sockaddr_in address;
+    int opt = 1;
+    int addrlen = sizeof(address);
+
+    // Session threads and pool workers take consecutive CPU indices and each worker process
+    // gets its own range, so pinned threads only share a CPU once the machine runs out of them
+    size_t first_cpu = static_cast<size_t>(max(worker_index, 0)) * 2 * static_cast<size_t>(options.num_threads);
+    MSTServer mst_server(options.num_threads, options.pin, options.node_local, first_cpu + options.num_threads);
+    // --headless skips the SFML windows so the server can be driven by load_client
+    mst_server.setVisualization(!options.headless);
+    mst_server.setDuplicatePolicy(options.duplicate_policy);
+    mst_server.setCompactionThreshold(options.compact_threshold);
+    mst_server.setSharedStore(store);
+    mst_server.setMemoryQuotas(options.client_memory_mb << 20, options.total_memory_mb << 20);
+    // Sessions are coroutines on their own threads; MST work goes to the server's pool
+    Scheduler scheduler(options.num_threads, options.pin, first_cpu);
+
+    // Periodically dump the metrics in Prometheus text format for a node_exporter textfile collector
+    if (!options.metrics_file.empty()) {
+        // every worker has its own counters, so each writes its own file
+        string metrics_file = options.metrics_file;
+        if (worker_index >= 0)
+            metrics_file += "." + to_string(worker_index);
+        thread([metrics_file]() {
+            while (server_running) {
+                if (!Metrics::writePrometheus(metrics_file))
+                    LOG_WARN("Failed to write metrics to %s", metrics_file.c_str());
+                this_thread::sleep_for(chrono::seconds(5));
+            }
+        }).detach();
+    }
 
-    MSTServer mst_server(num_threads);  // Pass num_threads to the constructor
-    ThreadPoll thread_pool(num_threads);
+    // Trims the spare capacity of graphs whose sessions have gone quiet; it uses the server,
+    // so it is joined before the server goes away
+    thread compactor;
+    if (options.idle_compact_seconds > 0) {
+        chrono::seconds idle_for(options.idle_compact_seconds);
+        compactor = thread([&mst_server, idle_for]() {
+            while (server_running) {
+                this_thread::sleep_for(min(idle_for, chrono::seconds(5)));
+                mst_server.compactIdleGraphs(idle_for);
+            }
+        });
+    }
 
-    cout << "Server listening on port " << PORT << " with " << num_threads << " threads" << endl;
+    LOG_INFO("Server listening on port %d with %d threads", PORT, options.num_threads);
 
     while (server_running) {
         if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) < 0) {
@@ -289,16 +886,197 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        cout << "New client connected" << endl;
+        LOG_INFO("New client connected");
+        Metrics::add(Metrics::CONNECTIONS_TOTAL);
+        // Replies are written as several small sends; don't let Nagle hold them back
+        setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
 
-        // Create a lambda function to handle the client and add it to the thread pool
-        thread_pool.enqueue(new_socket, [new_socket, &mst_server](int thread_id) {
-            handle_client(new_socket, mst_server, thread_id);
-            cout << "Client disconnected, thread " << thread_id << " is free" << endl;
-            close(new_socket);  // Close client socket when done
-        });
+        // The session starts on a scheduler thread and suspends at its first wait
+        scheduler.post(handle_client(new_socket, mst_server, scheduler).handle);
     }
 
     close(server_fd);
-    return 0;
-}
\ No newline at end of file
+    if (compactor.joinable())
+        compactor.join();
+}
+
+void stop_supervisor(int){
+    server_running = false;
+}
+
+pid_t spawn_worker(int index, const ServerOptions &options, SharedGraphStore &store){
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        worker_index = index;
+        serve(open_listener(), options, &store);
+        _exit(EXIT_SUCCESS);
+    }
+    return pid;
+}
+
+// Pre-fork mode: the supervisor only forks the workers and replaces any that crash. It never
+// logs through Logger, whose drain thread would not survive into the workers it forks.
+int supervise(int num_workers, const ServerOptions &options, SharedGraphStore &store){
+    struct sigaction action = {};
+    action.sa_handler = stop_supervisor;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    vector<pid_t> workers(num_workers);
+    vector<chrono::steady_clock::time_point> started(num_workers);
+    for (int i = 0; i < num_workers; ++i) {
+        workers[i] = spawn_worker(i, options, store);
+        started[i] = chrono::steady_clock::now();
+    }
+    cerr << "Supervisor " << getpid() << " started " << num_workers << " workers on port " << PORT << endl;
+
+    int running = count_if(workers.begin(), workers.end(), [](pid_t pid) { return pid > 0; });
+    while (server_running && running > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        auto it = find(workers.begin(), workers.end(), pid);
+        if (it == workers.end())
+            continue;
+        int index = static_cast<int>(it - workers.begin());
+        // the dead worker's sessions are gone, and so are the graphs only they held
+        store.releaseOwner(pid);
+        if (!WIFSIGNALED(status)) {
+            // a clean exit, or a worker that could not start (e.g. the port is taken)
+            cerr << "Worker " << index << " exited with status " << WEXITSTATUS(status) << endl;
+            *it = -1;
+            --running;
+            continue;
+        }
+        cerr << "Worker " << index << " (pid " << pid << ") killed by signal " << WTERMSIG(status)
+             << ", restarting" << endl;
+        // a worker that keeps crashing at startup is not restarted in a tight loop
+        if (chrono::steady_clock::now() - started[index] < chrono::seconds(1))
+            this_thread::sleep_for(chrono::seconds(1));
+        *it = spawn_worker(index, options, store);
+        started[index] = chrono::steady_clock::now();
+        if (*it < 0)
+            --running;
+    }
+
+    for (pid_t pid : workers) {
+        if (pid > 0)
+            kill(pid, SIGTERM);
+    }
+    for (pid_t pid : workers) {
+        if (pid > 0)
+            waitpid(pid, nullptr, 0);
+    }
+    return running > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Largest --*-mb value: 16 TiB, so the byte count cannot overflow
+const long long MAX_MEGABYTES = 1LL << 24;
+
+// Parses a --*-mb option into megabytes; false unless it is a whole number in 1 .. MAX_MEGABYTES
+bool parse_megabytes(const char *text, size_t &megabytes) {
+    char *end = nullptr;
+    errno = 0;
+    long long value = strtoll(text, &end, 10);
+    if (errno || end == text || *end != '\0' || value < 1 || value > MAX_MEGABYTES)
+        return false;
+    megabytes = static_cast<size_t>(value);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    bool valid_args = argc >= 2;
+    ServerOptions options;
+    int num_workers = 0;
+    size_t shared_store_mb = 256;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--headless")
+            options.headless = true;
+        else if (arg == "--metrics-file" && i + 1 < argc)
+            options.metrics_file = argv[++i];
+        else if (arg == "--duplicates" && i + 1 < argc) {
+            try {
+                options.duplicate_policy = parseDuplicatePolicy(argv[++i]);
+            }
+            catch (const runtime_error &) {
+                valid_args = false;
+            }
+        }
+        else if (arg == "--compact-threshold" && i + 1 < argc) {
+            options.compact_threshold = atof(argv[++i]);
+            if (options.compact_threshold < 0 || options.compact_threshold > 1)
+                valid_args = false;
+        }
+        else if (arg == "--pin" && i + 1 < argc) {
+            try {
+                options.pin = parsePinPolicy(argv[++i]);
+            }
+            catch (const runtime_error &) {
+                valid_args = false;
+            }
+        }
+        else if (arg == "--node-local")
+            options.node_local = true;
+        else if (arg == "--workers" && i + 1 < argc) {
+            num_workers = atoi(argv[++i]);
+            if (num_workers < 1)
+                valid_args = false;
+        }
+        else if (arg == "--shared-store-mb" && i + 1 < argc) {
+            if (!parse_megabytes(argv[++i], shared_store_mb))
+                valid_args = false;
+        }
+        else if (arg == "--client-memory-mb" && i + 1 < argc) {
+            if (!parse_megabytes(argv[++i], options.client_memory_mb))
+                valid_args = false;
+        }
+        else if (arg == "--total-memory-mb" && i + 1 < argc) {
+            if (!parse_megabytes(argv[++i], options.total_memory_mb))
+                valid_args = false;
+        }
+        else if (arg == "--idle-compact-seconds" && i + 1 < argc) {
+            options.idle_compact_seconds = atoi(argv[++i]);
+            if (options.idle_compact_seconds < 0)
+                valid_args = false;
+        }
+        else if (arg == "--log-level" && i + 1 < argc) {
+            string level = argv[++i];
+            const vector<string> levels = {"debug", "info", "warn", "error"};
+            auto it = find(levels.begin(), levels.end(), level);
+            if (it == levels.end())
+                valid_args = false;
+            else
+                Logger::setLevel(static_cast<int>(it - levels.begin()));
+        }
+        else
+            valid_args = false;
+    }
+    if (!valid_args) {
+        cerr << "Usage: " << argv[0] << " <number_of_threads> [--headless] [--metrics-file <path>]"
+             << " [--log-level debug|info|warn|error] [--duplicates allow|keep_min|replace|reject]"
+             << " [--compact-threshold <fraction>] [--workers <processes>] [--shared-store-mb <MiB>]"
+             << " [--pin none|compact|scatter] [--node-local] [--client-memory-mb <MiB>]"
+             << " [--total-memory-mb <MiB>] [--idle-compact-seconds <seconds, 0 for never>]" << endl;
+        return 1;
+    }
+    options.num_threads = stoi(argv[1]);
+
+    if (num_workers == 0) {
+        serve(open_listener(), options, nullptr);
+        return 0;
+    }
+    // mapped before the fork, so every worker, and every replacement, shares it
+    SharedGraphStore store(shared_store_mb << 20);
+    return supervise(num_workers, options, store);
+}